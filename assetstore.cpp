@@ -0,0 +1,374 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "assetstore.h"
+#include "reswriter.h"
+#include "util.h"
+
+#define ASSETSTORE_HEADER "RESGen assets 2"
+
+// Files changed this many seconds before the run started might change again
+// without getting a new modification time, their assets aren't stored
+#define ASSETSTORE_RACY 2
+
+namespace
+{
+	bool SameStamp(const dirstamp_s &a, const dirstamp_s &b)
+	{
+		return a.inode == b.inode && a.size == b.size && a.mtime == b.mtime && a.mtimensec == b.mtimensec;
+	}
+
+	// Paths and names are the rest of the line
+	bool HasNewline(const std::string &str)
+	{
+		return str.find_first_of("\r\n") != std::string::npos;
+	}
+}
+
+AssetStore::AssetStore()
+	: started(static_cast<long long>(time(NULL)))
+{
+}
+
+bool AssetStore::Load(const std::string &filename)
+{
+	records.clear();
+
+	if (!fileExists(filename))
+	{
+		return true;
+	}
+
+	std::string str;
+	if (!readFile(filename, str))
+	{
+		printf("Error: Could not open asset file %s!\n", filename.c_str());
+		return false;
+	}
+
+	Tokenizer<'\n'> tokenizer(str);
+	bool valid = true;
+	bool header = true;
+	bool ended = false;
+	Record *record = NULL;
+	std::vector<std::string> names; // Of the WAD in record
+	size_t textureCount = 0; // Of the WAD in record
+
+	for (const char *token = tokenizer.Next(); token && valid; token = tokenizer.Next())
+	{
+		std::string line = token;
+		rightTrim(line, "\r");
+
+		const char * const fields = line.c_str() + ((line.length() > 2) ? 2 : line.length());
+		int length = 0;
+
+		if (header)
+		{
+			valid = (line == ASSETSTORE_HEADER);
+			header = false;
+			continue;
+		}
+		else if (line.empty())
+		{
+			continue;
+		}
+		else if (ended)
+		{
+			valid = false;
+			continue;
+		}
+		else if (!line.compare(0, 2, "t ") && record && record->type == 'w')
+		{
+			// t <texture name>
+			valid = names.size() < textureCount;
+			names.push_back(fields);
+			continue;
+		}
+
+		// Any other line ends the texture names of the WAD before it, which
+		// must all be there
+		if (record && record->type == 'w')
+		{
+			valid = names.size() == textureCount;
+			record->textures.Assign(names);
+			names.clear();
+		}
+		record = NULL;
+
+		if (!valid)
+		{
+			continue;
+		}
+		else if (line == "end")
+		{
+			// Written last, a file without it was cut short
+			ended = true;
+		}
+		else if (!line.compare(0, 2, "w ") || !line.compare(0, 2, "m "))
+		{
+			// w <offset> <inode> <size> <mtime> <mtimensec> <texture count> <path>
+			// m <offset> <inode> <size> <mtime> <mtimensec> <exttexture> <path>
+			Record parsed;
+			unsigned int offset;
+			int exttexture = 0;
+
+			parsed.type = line[0];
+			parsed.exttexture = false;
+
+			valid = sscanf(fields, "%u %llu %llu %lld %ld%n",
+				&offset, &parsed.stamp.inode, &parsed.stamp.size, &parsed.stamp.mtime, &parsed.stamp.mtimensec, &length) == 5;
+
+			if (valid && parsed.type == 'm')
+			{
+				int flagLength = 0;
+				valid = sscanf(fields + length, " %d%n", &exttexture, &flagLength) == 1;
+				length += flagLength;
+				parsed.exttexture = (exttexture != 0);
+			}
+			else if (valid)
+			{
+				unsigned long long count;
+				int countLength = 0;
+				valid = sscanf(fields + length, " %llu%n", &count, &countLength) == 1;
+				length += countLength;
+				textureCount = static_cast<size_t>(count);
+			}
+
+			valid = valid && fields[length] == ' ';
+
+			if (valid)
+			{
+				record = &(records[MakeKey(fields + length + 1, offset)] = parsed);
+			}
+		}
+		else
+		{
+			valid = false;
+		}
+	}
+
+	if (!valid || header || !ended)
+	{
+		// Nothing is lost, the assets are just parsed again
+		printf("Warning: %s is not a valid RESGen asset file, ignoring it.\n", filename.c_str());
+		records.clear();
+	}
+
+	return true;
+}
+
+bool AssetStore::Save(const std::string &filename)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	std::string contents = ASSETSTORE_HEADER "\n";
+	std::vector<std::string> names;
+
+	for (RecordMap::const_iterator it = records.begin(); it != records.end(); ++it)
+	{
+		const Record &record = it->second;
+		const size_t separator = it->first.find(' ');
+		const std::string path = it->first.substr(separator + 1);
+
+		dirstamp_s stamp;
+		if (!GetStamp(path, stamp, lock) || !SameStamp(stamp, record.stamp))
+		{
+			continue;
+		}
+
+		appendFormat(contents, "%c %s %llu %llu %lld %ld ",
+			record.type, it->first.substr(0, separator).c_str(), record.stamp.inode, record.stamp.size, record.stamp.mtime, record.stamp.mtimensec);
+
+		if (record.type == 'm')
+		{
+			appendFormat(contents, "%d ", record.exttexture ? 1 : 0);
+		}
+		else
+		{
+			record.textures.GetNames(names);
+			appendFormat(contents, SIZE_T_SPECIFIER " ", names.size());
+		}
+
+		appendFormat(contents, "%s\n", path.c_str());
+
+		if (record.type == 'w')
+		{
+			for (std::vector<std::string>::const_iterator nameIt = names.begin(); nameIt != names.end(); ++nameIt)
+			{
+				appendFormat(contents, "t %s\n", nameIt->c_str());
+			}
+		}
+	}
+
+	contents += "end\n";
+
+	// Replaced in one step, like res files
+	std::string error;
+	if (!ResWriter::WriteResFile(filename, contents, error))
+	{
+		printf("Error: Could not write asset file %s!\n", filename.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool AssetStore::Contains(char type, const std::string &path, uint32_t offset)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return Find(type, path, offset, lock) != NULL;
+}
+
+bool AssetStore::FindWad(const std::string &path, uint32_t offset, TextureSet &textures)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	const Record *record = Find('w', path, offset, lock);
+	if (record == NULL)
+	{
+		return false;
+	}
+
+	textures = record->textures;
+	return true;
+}
+
+void AssetStore::StoreWad(const std::string &path, uint32_t offset, const TextureSet &textures)
+{
+	std::vector<std::string> names;
+	textures.GetNames(names);
+
+	for (std::vector<std::string>::const_iterator it = names.begin(); it != names.end(); ++it)
+	{
+		if (HasNewline(*it))
+		{
+			return;
+		}
+	}
+
+	Record record;
+	record.type = 'w';
+	record.exttexture = false;
+	record.textures = textures;
+	Store(path, offset, record);
+}
+
+bool AssetStore::FindModel(const std::string &path, uint32_t offset, bool &exttexture)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	const Record *record = Find('m', path, offset, lock);
+	if (record == NULL)
+	{
+		return false;
+	}
+
+	exttexture = record->exttexture;
+	return true;
+}
+
+void AssetStore::StoreModel(const std::string &path, uint32_t offset, bool exttexture)
+{
+	Record record;
+	record.type = 'm';
+	record.exttexture = exttexture;
+	Store(path, offset, record);
+}
+
+void AssetStore::BeginRun()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// Files may have changed since they were stamped
+	stamps.clear();
+	started = static_cast<long long>(time(NULL));
+}
+
+std::string AssetStore::MakeKey(const std::string &path, uint32_t offset)
+{
+	std::string key;
+	appendFormat(key, "%u ", offset);
+	return key + path;
+}
+
+const AssetStore::Record *AssetStore::Find(char type, const std::string &path, uint32_t offset, std::unique_lock<std::mutex> &lock)
+{
+	dirstamp_s stamp;
+	if (!GetStamp(path, stamp, lock))
+	{
+		return NULL;
+	}
+
+	RecordMap::const_iterator it = records.find(MakeKey(path, offset));
+	if (it == records.end() || it->second.type != type || !SameStamp(it->second.stamp, stamp))
+	{
+		return NULL;
+	}
+
+	return &it->second;
+}
+
+void AssetStore::Store(const std::string &path, uint32_t offset, const Record &record)
+{
+	if (HasNewline(path))
+	{
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	// The stamp from before the file was parsed, a change since then gets
+	// it parsed again next run
+	dirstamp_s stamp;
+	if (!GetStamp(path, stamp, lock) || stamp.mtime + ASSETSTORE_RACY >= started)
+	{
+		return;
+	}
+
+	Record &stored = records[MakeKey(path, offset)];
+	stored = record;
+	stored.stamp = stamp;
+}
+
+bool AssetStore::GetStamp(const std::string &path, dirstamp_s &stamp, std::unique_lock<std::mutex> &lock)
+{
+	StampMap::const_iterator it = stamps.find(path);
+	if (it != stamps.end())
+	{
+		stamp = it->second;
+		return true;
+	}
+
+	// Stat'ed without the lock, another thread may do the same file at once
+	lock.unlock();
+	const bool exists = DirCache::GetStamp(path, stamp);
+	lock.lock();
+
+	if (exists)
+	{
+		stamps[path] = stamp;
+	}
+
+	return exists;
+}
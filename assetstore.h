@@ -0,0 +1,94 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef ASSETSTORE_H
+#define ASSETSTORE_H
+
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "dircache.h"
+#include "wadcache.h"
+
+// What -u found out about each WAD and MDL file in earlier runs: the texture
+// names of WADs, and whether MDLs have an external texture file. Assets are
+// kept by the path of the file holding them, their offset in it (pak entries
+// only) and the stamp of that file, so a changed file is parsed again. Used
+// by several threads at once.
+class AssetStore
+{
+public:
+	typedef WadCache::TextureSet TextureSet;
+
+	AssetStore();
+
+	// A missing file gives an empty store
+	bool Load(const std::string &filename);
+
+	// Leaves out assets of which the file changed or was removed
+	bool Save(const std::string &filename);
+
+	// type is 'w' for WADs and 'm' for MDLs
+	bool Contains(char type, const std::string &path, uint32_t offset);
+
+	bool FindWad(const std::string &path, uint32_t offset, TextureSet &textures);
+	void StoreWad(const std::string &path, uint32_t offset, const TextureSet &textures);
+
+	bool FindModel(const std::string &path, uint32_t offset, bool &exttexture);
+	void StoreModel(const std::string &path, uint32_t offset, bool exttexture);
+
+	// Files changed before now can be trusted, for runs that keep going
+	void BeginRun();
+
+private:
+	AssetStore(const AssetStore &other);
+	AssetStore& operator=(const AssetStore &other);
+
+	struct Record
+	{
+		char type;
+		dirstamp_s stamp;
+		bool exttexture; // MDLs only
+		TextureSet textures; // WADs only
+	};
+	typedef std::map<std::string, Record> RecordMap;
+	typedef std::map<std::string, dirstamp_s> StampMap;
+
+	static std::string MakeKey(const std::string &path, uint32_t offset);
+
+	// Record of an asset whose file didn't change, or NULL. Must be called
+	// with mutex locked.
+	const Record *Find(char type, const std::string &path, uint32_t offset, std::unique_lock<std::mutex> &lock);
+	void Store(const std::string &path, uint32_t offset, const Record &record);
+
+	// False if path can't be stat'ed. Must be called with mutex locked.
+	bool GetStamp(const std::string &path, dirstamp_s &stamp, std::unique_lock<std::mutex> &lock);
+
+	RecordMap records; // By offset, a space and the path
+	StampMap stamps; // Files holding assets, stamped once per run
+	long long started; // Time this run started
+	std::mutex mutex;
+};
+
+#endif // ASSETSTORE_H
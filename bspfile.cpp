@@ -0,0 +1,196 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "bspfile.h"
+
+BspFile::BspFile()
+	: data(NULL)
+	, size(0)
+	, mapped(false)
+{
+}
+
+BspFile::~BspFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool BspFile::Open(const std::string &fileName, bool map)
+{
+	Close();
+
+	HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+	{
+		size = static_cast<size_t>(fileSize.QuadPart);
+
+		// The view keeps the mapping alive after its handle is closed
+		HANDLE mapping = map ? CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+		if (mapping != NULL)
+		{
+			data = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			CloseHandle(mapping);
+		}
+
+		mapped = (data != NULL);
+
+		if (!mapped)
+		{
+			buffer.resize(size);
+
+			DWORD bytesRead;
+			if (ReadFile(file, &buffer[0], static_cast<DWORD>(size), &bytesRead, NULL))
+			{
+				size = bytesRead;
+			}
+			else
+			{
+				size = 0;
+			}
+
+			data = size ? &buffer[0] : NULL;
+		}
+	}
+
+	CloseHandle(file);
+	return true;
+}
+
+void BspFile::Close()
+{
+	if (mapped)
+	{
+		UnmapViewOfFile(data);
+	}
+
+	data = NULL;
+	size = 0;
+	mapped = false;
+	buffer.clear();
+}
+
+#else
+
+bool BspFile::Open(const std::string &fileName, bool map)
+{
+	Close();
+
+	const int fd = open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		size = static_cast<size_t>(st.st_size);
+
+		void *mapping = map ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+		mapped = (mapping != MAP_FAILED);
+
+		if (mapped)
+		{
+			data = static_cast<const char *>(mapping);
+		}
+		else
+		{
+			buffer.resize(size);
+
+			size_t total = 0;
+			while (total < size)
+			{
+				const ssize_t bytes = read(fd, &buffer[total], size - total);
+				if (bytes <= 0)
+				{
+					break;
+				}
+				total += static_cast<size_t>(bytes);
+			}
+
+			size = total;
+			data = size ? &buffer[0] : NULL;
+		}
+	}
+
+	close(fd);
+	return true;
+}
+
+void BspFile::Close()
+{
+	if (mapped)
+	{
+		munmap(const_cast<char *>(data), size);
+	}
+
+	data = NULL;
+	size = 0;
+	mapped = false;
+	buffer.clear();
+}
+
+#endif // _WIN32
+
+const char *BspFile::GetData() const
+{
+	return data;
+}
+
+size_t BspFile::GetSize() const
+{
+	return size;
+}
+
+bool BspFile::GetLump(const lumpinfo_s &lump, const char *&lumpData, size_t &lumpLength) const
+{
+	if (lump.fileofs < 0)
+	{
+		return false;
+	}
+
+	const size_t offset = static_cast<size_t>(lump.fileofs);
+	if (offset > size || lump.filelen > size - offset)
+	{
+		return false;
+	}
+
+	lumpData = data + offset;
+	lumpLength = lump.filelen;
+	return true;
+}
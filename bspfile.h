@@ -0,0 +1,65 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef BSPFILE_H
+#define BSPFILE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "hltypes.h"
+
+// Read-only view of a whole BSP file. The file is memory mapped, so lumps
+// can be parsed in place without copying them. If mapping fails the file
+// is read into memory instead.
+//
+// Files that may be cut short while they are parsed must not be mapped:
+// reading a mapped page past the new end kills the process with SIGBUS,
+// while a read file just fails the lump checks.
+class BspFile
+{
+public:
+	BspFile();
+	~BspFile();
+
+	// False if the file can't be opened. Read into memory if map is false.
+	bool Open(const std::string &fileName, bool map = true);
+	void Close();
+
+	// Start of the file, NULL if it is empty
+	const char *GetData() const;
+	size_t GetSize() const;
+
+	// Points data at a lump. False if the lump doesn't fit in the file.
+	bool GetLump(const lumpinfo_s &lump, const char *&lumpData, size_t &lumpLength) const;
+
+private:
+	BspFile(const BspFile &other);
+	BspFile& operator=(const BspFile &other);
+
+	const char *data;
+	size_t size;
+	bool mapped; // data is a mapping, otherwise it points into buffer
+	std::vector<char> buffer;
+};
+
+#endif // BSPFILE_H
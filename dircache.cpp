@@ -0,0 +1,271 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "dircache.h"
+#include "reswriter.h"
+#include "util.h"
+
+#define DIRCACHE_HEADER "RESGen cache 2"
+
+// Directories changed this many seconds before the run started might change
+// again without getting a new modification time, they aren't stored
+#define DIRCACHE_RACY 2
+
+namespace
+{
+	bool SameStamp(const dirstamp_s &a, const dirstamp_s &b)
+	{
+		return a.inode == b.inode && a.size == b.size && a.mtime == b.mtime && a.mtimensec == b.mtimensec;
+	}
+
+	// The path or name is the rest of the line
+	bool HasNewline(const std::string &str)
+	{
+		return str.find_first_of("\r\n") != std::string::npos;
+	}
+}
+
+DirCache::DirCache()
+	: started(static_cast<long long>(time(NULL)))
+{
+}
+
+bool DirCache::Load(const std::string &filename)
+{
+	records.clear();
+
+	if (!fileExists(filename))
+	{
+		return true;
+	}
+
+	std::string str;
+	if (!readFile(filename, str))
+	{
+		printf("Error: Could not open cache file %s!\n", filename.c_str());
+		return false;
+	}
+
+	Tokenizer<'\n'> tokenizer(str);
+	bool valid = true;
+	bool header = true;
+	bool ended = false;
+	Record *record = NULL;
+	size_t entryCount = 0; // Of record
+
+	for (const char *token = tokenizer.Next(); token && valid; token = tokenizer.Next())
+	{
+		std::string line = token;
+		rightTrim(line, "\r");
+
+		// The path or name is everything after the single space that
+		// follows the numbers, it may start with spaces itself
+		const char * const fields = line.c_str() + ((line.length() > 2) ? 2 : line.length());
+		int length = 0;
+
+		if (header)
+		{
+			valid = (line == DIRCACHE_HEADER);
+			header = false;
+		}
+		else if (line.empty())
+		{
+			continue;
+		}
+		else if (ended)
+		{
+			valid = false;
+		}
+		else if (record && record->listing.entries.size() != entryCount && (line == "end" || !line.compare(0, 2, "d ")))
+		{
+			// The listing before lost entries
+			valid = false;
+		}
+		else if (line == "end")
+		{
+			// Written last, a file without it was cut short
+			ended = true;
+		}
+		else if (!line.compare(0, 2, "d "))
+		{
+			// d <section> <inode> <size> <mtime> <mtimensec> <count> <entry count> <path>
+			char section[32];
+			Record parsed;
+			unsigned long long count;
+			unsigned long long entries;
+
+			valid = sscanf(fields, "%31s %llu %llu %lld %ld %llu %llu%n",
+				section, &parsed.stamp.inode, &parsed.stamp.size, &parsed.stamp.mtime, &parsed.stamp.mtimensec, &count, &entries, &length) == 7
+				&& fields[length] == ' ';
+
+			if (valid)
+			{
+				parsed.listing.count = static_cast<size_t>(count);
+				parsed.used = false;
+				entryCount = static_cast<size_t>(entries);
+
+				std::string key = section;
+				key += ' ';
+				key += fields + length + 1;
+				record = &(records[key] = parsed);
+			}
+		}
+		else if (!line.compare(0, 2, "e ") && record)
+		{
+			// e <type> <offset> <length> <name>
+			direntry_s entry;
+
+			valid = record->listing.entries.size() < entryCount
+				&& sscanf(fields, "%c %u %u%n", &entry.type, &entry.offset, &entry.length, &length) == 3
+				&& fields[length] == ' ';
+
+			if (valid)
+			{
+				entry.name = fields + length + 1;
+				record->listing.entries.push_back(entry);
+			}
+		}
+		else
+		{
+			valid = false;
+		}
+	}
+
+	if (!valid || header || !ended)
+	{
+		// Nothing is lost, the walk just can't skip anything
+		printf("Warning: %s is not a valid RESGen cache file, ignoring it.\n", filename.c_str());
+		records.clear();
+	}
+
+	return true;
+}
+
+bool DirCache::Save(const std::string &filename) const
+{
+	std::string contents = DIRCACHE_HEADER "\n";
+
+	for (RecordMap::const_iterator it = records.begin(); it != records.end(); ++it)
+	{
+		const Record &record = it->second;
+		if (!record.used)
+		{
+			continue;
+		}
+
+		const size_t separator = it->first.find(' ');
+		appendFormat(contents, "d %s %llu %llu %lld %ld %llu %llu %s\n",
+			it->first.substr(0, separator).c_str(), record.stamp.inode, record.stamp.size, record.stamp.mtime, record.stamp.mtimensec,
+			static_cast<unsigned long long>(record.listing.count), static_cast<unsigned long long>(record.listing.entries.size()),
+			it->first.c_str() + separator + 1);
+
+		for (std::vector<direntry_s>::const_iterator entryIt = record.listing.entries.begin(); entryIt != record.listing.entries.end(); ++entryIt)
+		{
+			appendFormat(contents, "e %c %u %u %s\n", entryIt->type, entryIt->offset, entryIt->length, entryIt->name.c_str());
+		}
+	}
+
+	contents += "end\n";
+
+	// Replaced in one step, like res files
+	std::string error;
+	if (!ResWriter::WriteResFile(filename, contents, error))
+	{
+		printf("Error: Could not write cache file %s!\n", filename.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool DirCache::GetStamp(const std::string &path, dirstamp_s &stamp)
+{
+	struct stat filestatinfo; // Force as a struct for GCC
+	if (stat(path.c_str(), &filestatinfo))
+	{
+		return false;
+	}
+
+	stamp.inode = static_cast<unsigned long long>(filestatinfo.st_ino);
+	stamp.size = static_cast<unsigned long long>(filestatinfo.st_size);
+	stamp.mtime = static_cast<long long>(filestatinfo.st_mtime);
+#ifdef __linux__
+	stamp.mtimensec = static_cast<long>(filestatinfo.st_mtim.tv_nsec);
+#else
+	stamp.mtimensec = 0;
+#endif
+
+	return true;
+}
+
+bool DirCache::Find(const char *section, const std::string &path, const dirstamp_s &stamp, Listing &listing)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	RecordMap::iterator it = records.find(section + (' ' + path));
+	if (it == records.end() || !SameStamp(it->second.stamp, stamp))
+	{
+		return false;
+	}
+
+	it->second.used = true;
+	listing = it->second.listing;
+	return true;
+}
+
+void DirCache::Store(const char *section, const std::string &path, const dirstamp_s &stamp, const Listing &listing)
+{
+	// Something may change it again this second without a new stamp, so
+	// it is listed again next time
+	if (stamp.mtime + DIRCACHE_RACY >= started || HasNewline(path))
+	{
+		return;
+	}
+
+	for (std::vector<direntry_s>::const_iterator it = listing.entries.begin(); it != listing.entries.end(); ++it)
+	{
+		if (HasNewline(it->name))
+		{
+			return;
+		}
+	}
+
+	Record record;
+	record.stamp = stamp;
+	record.listing = listing;
+	record.used = true;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	records[section + (' ' + path)] = record;
+}
+
+void DirCache::BeginRun()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	started = static_cast<long long>(time(NULL));
+}
@@ -0,0 +1,97 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef DIRCACHE_H
+#define DIRCACHE_H
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Identifies the state of a directory or file. A directory gets a new
+// modification time whenever an entry is added, removed or renamed.
+struct dirstamp_s
+{
+	unsigned long long inode;
+	unsigned long long size;
+	long long mtime;
+	long mtimensec;
+};
+
+struct direntry_s
+{
+	char type; // 'd' directory, 'f' file, 'p' pak file
+	std::string name;
+	uint32_t offset; // Pak file entries only
+	uint32_t length; // Pak file entries only
+};
+
+// What a walk kept of each directory, and the file lists of pak files, from
+// the previous run. Only directories whose stamp changed since have to be
+// listed again. Used by several threads of a walk at once.
+class DirCache
+{
+public:
+	struct Listing
+	{
+		size_t count; // Pak files: number of files in the pak
+		std::vector<direntry_s> entries; // In the order they were found
+	};
+
+	DirCache();
+
+	// A missing file gives an empty cache
+	bool Load(const std::string &filename);
+
+	// Only keeps what was looked up or stored since Load
+	bool Save(const std::string &filename) const;
+
+	// False if path can't be stat'ed
+	static bool GetStamp(const std::string &path, dirstamp_s &stamp);
+
+	// Listings are kept apart by section, as walks keep different entries
+	bool Find(const char *section, const std::string &path, const dirstamp_s &stamp, Listing &listing);
+	void Store(const char *section, const std::string &path, const dirstamp_s &stamp, const Listing &listing);
+
+	// Directories changed before now can be trusted, for runs that keep going
+	void BeginRun();
+
+private:
+	DirCache(const DirCache &other);
+	DirCache& operator=(const DirCache &other);
+
+	struct Record
+	{
+		dirstamp_s stamp;
+		Listing listing;
+		bool used;
+	};
+	typedef std::map<std::string, Record> RecordMap;
+
+	RecordMap records; // By section, a space and the path
+	long long started; // Time this run started
+	std::mutex mutex;
+};
+
+#endif // DIRCACHE_H
@@ -0,0 +1,202 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <stdint.h>
+#include <sys/syscall.h>
+#endif
+
+#include "dirreader.h"
+
+#ifdef __linux__
+
+// Size of a getdents64 batch
+#define DIRREADER_BUFFER 65536
+
+namespace
+{
+	// What getdents64 returns, not every libc declares it
+	struct dirent64_s
+	{
+		uint64_t d_ino;
+		int64_t d_off;
+		unsigned short d_reclen;
+		unsigned char d_type;
+		char d_name[1];
+	};
+}
+
+#endif
+
+DirReader::DirReader()
+	: fd(-1)
+	, follow(false)
+#ifdef __linux__
+	, position(0)
+	, end(0)
+#else
+	, directory(NULL)
+#endif
+{
+}
+
+DirReader::~DirReader()
+{
+	Close();
+}
+
+bool DirReader::Open(const std::string &path, bool followlinks)
+{
+	Close();
+
+	follow = followlinks;
+	fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	if (fd < 0)
+	{
+		return false;
+	}
+
+#ifdef __linux__
+	buffer.resize(DIRREADER_BUFFER);
+	position = end = 0;
+#else
+	directory = fdopendir(fd);
+	if (directory == NULL)
+	{
+		close(fd);
+		fd = -1;
+		return false;
+	}
+#endif
+
+	return true;
+}
+
+const char *DirReader::Next(bool &isdirectory)
+{
+	if (fd < 0)
+	{
+		return NULL;
+	}
+
+	while (true)
+	{
+#ifdef __linux__
+		if (position >= end)
+		{
+			const long bytes = syscall(SYS_getdents64, fd, &buffer[0], buffer.size());
+			if (bytes <= 0)
+			{
+				return NULL;
+			}
+
+			position = 0;
+			end = static_cast<size_t>(bytes);
+		}
+
+		const dirent64_s *entry = reinterpret_cast<const dirent64_s *>(&buffer[position]);
+		position += entry->d_reclen;
+#else
+		const dirent *entry = readdir(directory);
+		if (entry == NULL)
+		{
+			return NULL;
+		}
+#endif
+
+		const char *name = entry->d_name;
+
+		if (!strcmp(name, ".") || !strcmp(name, ".."))
+		{
+			continue;
+		}
+
+		if (GetType(name, entry->d_type, isdirectory))
+		{
+			return name;
+		}
+	}
+}
+
+void DirReader::Close()
+{
+#ifndef __linux__
+	if (directory != NULL)
+	{
+		// Closes fd as well
+		closedir(directory);
+		directory = NULL;
+		fd = -1;
+	}
+#endif
+
+	if (fd >= 0)
+	{
+		close(fd);
+		fd = -1;
+	}
+}
+
+bool DirReader::GetType(const char *name, unsigned char type, bool &isdirectory) const
+{
+	if (type == DT_DIR)
+	{
+		isdirectory = true;
+		return true;
+	}
+
+	if (type == DT_LNK && !follow)
+	{
+		return false;
+	}
+
+	if (type != DT_LNK && type != DT_UNKNOWN)
+	{
+		isdirectory = false;
+		return true;
+	}
+
+	// Only now it's worth a system call
+	struct stat filestatinfo; // Force as a struct for GCC
+	if (fstatat(fd, name, &filestatinfo, follow ? 0 : AT_SYMLINK_NOFOLLOW))
+	{
+		return false;
+	}
+
+	if (S_ISLNK(filestatinfo.st_mode))
+	{
+		return false;
+	}
+
+	isdirectory = S_ISDIR(filestatinfo.st_mode);
+	return true;
+}
+
+#endif // !_WIN32
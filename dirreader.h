@@ -0,0 +1,72 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef DIRREADER_H
+#define DIRREADER_H
+
+#ifndef _WIN32
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+
+// Lists the entries of a directory with as few system calls as possible.
+// On Linux entries are read in large getdents64 batches. The type the file
+// system reports is trusted, an entry is only stat'ed (relative to the
+// directory, so no path is built) if its type is unknown or it is a
+// symlink that has to be followed. "." and ".." are skipped.
+class DirReader
+{
+public:
+	DirReader();
+	~DirReader();
+
+	// If followlinks is false, symlinks are skipped
+	bool Open(const std::string &path, bool followlinks);
+
+	// Returns the name of the next file or directory, or NULL when done.
+	// The name is valid until the next call.
+	const char *Next(bool &directory);
+
+	void Close();
+
+private:
+	DirReader(const DirReader &other);
+	DirReader& operator=(const DirReader &other);
+
+	bool GetType(const char *name, unsigned char type, bool &directory) const;
+
+	int fd;
+	bool follow;
+#ifdef __linux__
+	std::vector<char> buffer;
+	size_t position;
+	size_t end;
+#else
+	DIR *directory;
+#endif
+};
+
+#endif // !_WIN32
+
+#endif // DIRREADER_H
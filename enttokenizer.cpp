@@ -19,13 +19,15 @@ along with RESGen; if not, write to the Free Software
 Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
+#include <string.h>
+
 #include "enttokenizer.h"
 #include "util.h"
 
-EntTokenizer::EntTokenizer(std::string& str_)
-	: str(str_)
-	, currentPtr(&str[0])
-	, strEnd(currentPtr + str.length())
+EntTokenizer::EntTokenizer(const char *data, size_t length)
+	: strBegin(data)
+	, currentPtr(data)
+	, strEnd(data + length)
 	, bInBlock(false)
 	, blocksRead(0)
 	, keyLength(0)
@@ -40,7 +42,7 @@ int EntTokenizer::GetCharNum() const
 		return -1;
 	}
 
-	return currentPtr - &str[0];
+	return currentPtr - strBegin;
 }
 
 int EntTokenizer::GetNumBlocksRead() const
@@ -58,6 +60,12 @@ ptrdiff_t EntTokenizer::GetLatestValueLength() const
 	return valueLength;
 }
 
+bool EntTokenizer::KeyIs(const char *key) const
+{
+	const size_t length = strlen(key);
+	return (static_cast<size_t>(keyLength) == length) && !memcmp(pair.first, key, length);
+}
+
 const EntTokenizer::KeyValuePair* EntTokenizer::NextPair()
 {
 	// Have we finished parsing?
@@ -85,7 +93,7 @@ const EntTokenizer::KeyValuePair* EntTokenizer::NextPair()
 	{
 		throw ParseException("Failed to parse key of key-value pair.", GetCharNum());
 	}
-	// currentPtr points to char after NUL
+	// currentPtr points to char after closing quote
 	keyLength = (currentPtr ? currentPtr - 1 : strEnd) - pair.first;
 
 	// Ignore space between key/value
@@ -97,7 +105,7 @@ const EntTokenizer::KeyValuePair* EntTokenizer::NextPair()
 	{
 		throw ParseException("Failed to parse value of key-value pair.", GetCharNum());
 	}
-	// currentPtr points to char after NUL
+	// currentPtr points to char after closing quote
 	valueLength = (currentPtr ? currentPtr - 1 : strEnd) - pair.second;
 
 	return &pair;
@@ -114,7 +122,6 @@ bool EntTokenizer::Next()
 	{
 		if(*currentPtr == '\"')
 		{
-			*currentPtr = 0;
 			currentPtr++;
 			return true;
 		}
@@ -131,7 +138,6 @@ void EntTokenizer::ParseKVSeparator()
 	{
 		if(*currentPtr == '\"')
 		{
-			*currentPtr = 0;
 			currentPtr++;
 			return;
 		}
@@ -153,7 +159,6 @@ bool EntTokenizer::NextKV()
 		switch(*currentPtr)
 		{
 			case '\"':
-				*currentPtr = 0;
 				currentPtr++;
 				return true;
 			case '{':
@@ -25,12 +25,15 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <cstddef>
 #include <string>
 
+// Splits entity data into key-value pairs. The data is only read, so keys
+// and values point into it and are not NUL terminated, use the latest
+// key and value lengths instead.
 class EntTokenizer
 {
 public:
 	typedef std::pair<const char*, const char*> KeyValuePair;
 
-	EntTokenizer(std::string& str_);
+	EntTokenizer(const char *data, size_t length);
 
 	int GetCharNum() const;
 
@@ -39,6 +42,9 @@ public:
 	ptrdiff_t GetLatestKeyLength() const;
 	ptrdiff_t GetLatestValueLength() const;
 
+	// Compares the latest key to a NUL terminated string
+	bool KeyIs(const char *key) const;
+
 	const KeyValuePair* NextPair();
 
 protected:
@@ -52,13 +58,14 @@ protected:
 	bool NextKV();
 
 protected:
-	std::string str;
+	// Start of the data
+	const char* strBegin;
 
-	// Current position in string
-	char* currentPtr;
+	// Current position in data
+	const char* currentPtr;
 
 	// Pointer to char after last
-	char* strEnd;
+	const char* strEnd;
 
 	bool bInBlock;
 	int blocksRead;
@@ -0,0 +1,549 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+// define NO_IO_URING to always read headers with the File class
+#if defined(__linux__) && !defined(NO_IO_URING)
+#define USE_IO_URING
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef USE_IO_URING
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "headerreader.h"
+
+#ifdef USE_IO_URING
+
+// Submission queue size, larger batches are split
+#define RING_ENTRIES 64
+
+// Just enough io_uring to run a batch of operations and wait for all of
+// them, using the raw system calls so liburing isn't needed
+class IoRing
+{
+public:
+	IoRing();
+	~IoRing();
+
+	// False if the kernel lacks io_uring or one of the operations we use
+	bool IsValid() const;
+
+	// Runs all operations. results[i] is the result of ops[i], or
+	// -ECANCELED if it was never submitted. Returns false if the ring
+	// failed, once all operations that were submitted have completed.
+	bool Run(std::vector<io_uring_sqe> &ops, std::vector<int> &results);
+
+private:
+	IoRing(const IoRing &other);
+	IoRing& operator=(const IoRing &other);
+
+	bool SupportsOps() const;
+
+	int fd;
+	bool valid;
+
+	void *sqRing;
+	size_t sqRingSize;
+	void *cqRing;
+	size_t cqRingSize;
+	void *sqeMemory;
+	size_t sqeMemorySize;
+
+	unsigned int sqEntries;
+	unsigned int *sqTail;
+	unsigned int *sqMask;
+	unsigned int *sqArray;
+	io_uring_sqe *sqes;
+
+	unsigned int *cqHead;
+	unsigned int *cqTail;
+	unsigned int *cqMask;
+	io_uring_cqe *cqes;
+};
+
+IoRing::IoRing()
+	: fd(-1)
+	, valid(false)
+	, sqRing(MAP_FAILED)
+	, sqRingSize(0)
+	, cqRing(MAP_FAILED)
+	, cqRingSize(0)
+	, sqeMemory(MAP_FAILED)
+	, sqeMemorySize(0)
+{
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	fd = static_cast<int>(syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+	if (fd < 0)
+	{
+		return;
+	}
+
+	sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (singleMap)
+	{
+		sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+	}
+
+	sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (sqRing == MAP_FAILED)
+	{
+		return;
+	}
+
+	if (!singleMap)
+	{
+		cqRing = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (cqRing == MAP_FAILED)
+		{
+			return;
+		}
+	}
+
+	sqeMemorySize = params.sq_entries * sizeof(io_uring_sqe);
+	sqeMemory = mmap(NULL, sqeMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (sqeMemory == MAP_FAILED)
+	{
+		return;
+	}
+
+	char *sq = static_cast<char *>(sqRing);
+	char *cq = static_cast<char *>(singleMap ? sqRing : cqRing);
+
+	sqEntries = params.sq_entries;
+	sqTail = reinterpret_cast<unsigned int *>(sq + params.sq_off.tail);
+	sqMask = reinterpret_cast<unsigned int *>(sq + params.sq_off.ring_mask);
+	sqArray = reinterpret_cast<unsigned int *>(sq + params.sq_off.array);
+	sqes = static_cast<io_uring_sqe *>(sqeMemory);
+
+	cqHead = reinterpret_cast<unsigned int *>(cq + params.cq_off.head);
+	cqTail = reinterpret_cast<unsigned int *>(cq + params.cq_off.tail);
+	cqMask = reinterpret_cast<unsigned int *>(cq + params.cq_off.ring_mask);
+	cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+	valid = SupportsOps();
+}
+
+IoRing::~IoRing()
+{
+	if (sqeMemory != MAP_FAILED)
+	{
+		munmap(sqeMemory, sqeMemorySize);
+	}
+
+	if (cqRing != MAP_FAILED)
+	{
+		munmap(cqRing, cqRingSize);
+	}
+
+	if (sqRing != MAP_FAILED)
+	{
+		munmap(sqRing, sqRingSize);
+	}
+
+	if (fd >= 0)
+	{
+		close(fd);
+	}
+}
+
+bool IoRing::IsValid() const
+{
+	return valid;
+}
+
+bool IoRing::SupportsOps() const
+{
+	// OPENAT, READ and CLOSE only exist since Linux 5.6
+	const unsigned int opCount = 256;
+	io_uring_probe *probe = static_cast<io_uring_probe *>(calloc(1, sizeof(io_uring_probe) + opCount * sizeof(io_uring_probe_op)));
+	if (probe == NULL)
+	{
+		return false;
+	}
+
+	bool supported = false;
+
+	if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, opCount) >= 0)
+	{
+		const unsigned int ops[] = { IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE };
+
+		supported = true;
+		for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++)
+		{
+			if (ops[i] > probe->last_op || !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED))
+			{
+				supported = false;
+			}
+		}
+	}
+
+	free(probe);
+	return supported;
+}
+
+bool IoRing::Run(std::vector<io_uring_sqe> &ops, std::vector<int> &results)
+{
+	results.assign(ops.size(), -ECANCELED);
+
+	bool failed = false;
+
+	for (size_t first = 0; first < ops.size() && !failed; )
+	{
+		const unsigned int count = static_cast<unsigned int>(std::min<size_t>(ops.size() - first, sqEntries));
+
+		// Only we move the tail, the kernel moves the head
+		unsigned int tail = *sqTail;
+		for (unsigned int i = 0; i < count; i++, tail++)
+		{
+			const unsigned int index = tail & *sqMask;
+			sqes[index] = ops[first + i];
+			sqes[index].user_data = first + i;
+			sqArray[index] = index;
+		}
+		__atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+		unsigned int submitted = 0;
+		unsigned int completed = 0;
+		while (completed < (failed ? submitted : count))
+		{
+			// After a failure nothing more is submitted, but whatever was
+			// submitted still reads into buffers and opens descriptors of the
+			// caller, so it has to complete before Run returns
+			const unsigned int submit = failed ? 0 : count - submitted;
+			const unsigned int wait = (failed ? submitted : count) - completed;
+
+			const long ret = syscall(__NR_io_uring_enter, fd, submit, wait, IORING_ENTER_GETEVENTS, NULL, 0);
+			if (ret < 0)
+			{
+				if (errno == EINTR || (failed && (errno == EAGAIN || errno == EBUSY)))
+				{
+					continue;
+				}
+
+				if (failed)
+				{
+					// Can't even wait, what is still in flight is lost
+					return false;
+				}
+
+				// Take back the entries the kernel didn't consume
+				__atomic_store_n(sqTail, tail - (count - submitted), __ATOMIC_RELEASE);
+				failed = true;
+				continue;
+			}
+			submitted += static_cast<unsigned int>(ret);
+
+			unsigned int head = *cqHead;
+			const unsigned int cqtail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+			for (; head != cqtail; head++, completed++)
+			{
+				const io_uring_cqe &cqe = cqes[head & *cqMask];
+				results[cqe.user_data] = cqe.res;
+			}
+			__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+		}
+
+		first += count;
+	}
+
+	return !failed;
+}
+
+#else
+
+class IoRing
+{
+};
+
+#endif // USE_IO_URING
+
+HeaderReader::HeaderReader()
+	: ringTried(false)
+{
+}
+
+HeaderReader::HeaderReader(const HeaderReader &other)
+	: ringTried(false)
+{
+	(void)other;
+}
+
+HeaderReader::~HeaderReader()
+{
+	Close();
+}
+
+bool HeaderReader::UseRing()
+{
+#ifdef USE_IO_URING
+	if (!ringTried)
+	{
+		ringTried = true;
+		ring.reset(new IoRing);
+
+		if (!ring->IsValid())
+		{
+			ring.reset();
+		}
+	}
+#endif
+
+	return ring.get() != NULL;
+}
+
+void HeaderReader::Begin()
+{
+	Close();
+}
+
+size_t HeaderReader::Add(const std::string &path)
+{
+	Entry entry;
+	entry.path = path;
+	entry.base = 0;
+	entry.limit = static_cast<size_t>(-1);
+	entry.fd = -1;
+	entries.push_back(std::move(entry));
+
+	return entries.size() - 1;
+}
+
+size_t HeaderReader::AddRange(const std::string &path, long base, size_t length)
+{
+	const size_t file = Add(path);
+	entries[file].base = base;
+	entries[file].limit = length;
+
+	return file;
+}
+
+void HeaderReader::Open()
+{
+#ifdef USE_IO_URING
+	if (UseRing())
+	{
+		std::vector<io_uring_sqe> ops(entries.size());
+		for (size_t i = 0; i < ops.size(); i++)
+		{
+			memset(&ops[i], 0, sizeof(io_uring_sqe));
+			ops[i].opcode = IORING_OP_OPENAT;
+			ops[i].fd = AT_FDCWD;
+			ops[i].addr = reinterpret_cast<uintptr_t>(entries[i].path.c_str());
+			ops[i].open_flags = O_RDONLY | O_CLOEXEC;
+		}
+
+		std::vector<int> results;
+		if (!ring->Run(ops, results))
+		{
+			// Files that didn't open use the File class below
+			ring.reset();
+		}
+
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			if (results[i] >= 0)
+			{
+				entries[i].fd = results[i];
+			}
+		}
+
+		if (ring)
+		{
+			return;
+		}
+	}
+#endif
+
+	for (std::vector<Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+	{
+		if (it->fd >= 0)
+		{
+			continue;
+		}
+
+		it->file.reset(new File(it->path, "rb"));
+	}
+}
+
+bool HeaderReader::IsOpen(size_t file) const
+{
+	const Entry &entry = entries[file];
+	return (entry.fd >= 0) || (entry.file && static_cast<FILE *>(*entry.file) != NULL);
+}
+
+void HeaderReader::Queue(size_t file, long offset, size_t length, std::string &data)
+{
+	const Entry &entry = entries[file];
+
+	// Never read past the end of a range
+	if (offset < 0 || static_cast<size_t>(offset) >= entry.limit)
+	{
+		length = 0;
+	}
+	else if (length > entry.limit - static_cast<size_t>(offset))
+	{
+		length = entry.limit - static_cast<size_t>(offset);
+	}
+
+	ReadJob job;
+	job.file = file;
+	job.offset = entry.base + offset;
+	job.length = length;
+	job.data = &data;
+	reads.push_back(job);
+}
+
+void HeaderReader::Read()
+{
+#ifdef USE_IO_URING
+	std::vector<io_uring_sqe> ops;
+	std::vector<std::string *> opData;
+#endif
+
+	for (std::vector<ReadJob>::const_iterator it = reads.begin(); it != reads.end(); ++it)
+	{
+		Entry &entry = entries[it->file];
+		std::string &data = *it->data;
+		data.resize(it->length);
+
+		if (!IsOpen(it->file))
+		{
+			data.clear();
+		}
+#ifdef USE_IO_URING
+		else if (entry.fd >= 0 && ring)
+		{
+			io_uring_sqe op;
+			memset(&op, 0, sizeof(op));
+			op.opcode = IORING_OP_READ;
+			op.fd = entry.fd;
+			op.addr = reinterpret_cast<uintptr_t>(&data[0]);
+			op.len = static_cast<unsigned int>(it->length);
+			op.off = static_cast<unsigned long long>(it->offset);
+			ops.push_back(op);
+			opData.push_back(&data);
+		}
+		else if (entry.fd >= 0)
+		{
+			// The ring failed after opening this file
+			const ssize_t bytes = pread(entry.fd, &data[0], it->length, it->offset);
+			data.resize((bytes > 0) ? static_cast<size_t>(bytes) : 0);
+		}
+#endif
+		else if (fseek(*entry.file, it->offset, SEEK_SET))
+		{
+			data.clear();
+		}
+		else
+		{
+			data.resize(fread(&data[0], 1, it->length, *entry.file));
+		}
+	}
+
+	reads.clear();
+
+#ifdef USE_IO_URING
+	if (!ops.empty())
+	{
+		std::vector<int> results;
+		if (!ring->Run(ops, results))
+		{
+			ring.reset();
+		}
+
+		for (size_t i = 0; i < opData.size(); i++)
+		{
+			ssize_t bytes = results[i];
+			if (bytes == -ECANCELED)
+			{
+				// The ring failed before this read was submitted
+				bytes = pread(ops[i].fd, &(*opData[i])[0], ops[i].len, static_cast<off_t>(ops[i].off));
+			}
+
+			opData[i]->resize((bytes > 0) ? static_cast<size_t>(bytes) : 0);
+		}
+	}
+#endif
+}
+
+void HeaderReader::Close()
+{
+#ifdef USE_IO_URING
+	std::vector<io_uring_sqe> ops;
+
+	for (std::vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+	{
+		if (it->fd < 0)
+		{
+			continue;
+		}
+
+		if (ring)
+		{
+			io_uring_sqe op;
+			memset(&op, 0, sizeof(op));
+			op.opcode = IORING_OP_CLOSE;
+			op.fd = it->fd;
+			ops.push_back(op);
+		}
+		else
+		{
+			close(it->fd);
+		}
+	}
+
+	if (!ops.empty())
+	{
+		std::vector<int> results;
+		if (!ring->Run(ops, results))
+		{
+			ring.reset();
+
+			for (size_t i = 0; i < ops.size(); i++)
+			{
+				if (results[i] == -ECANCELED)
+				{
+					close(ops[i].fd);
+				}
+			}
+		}
+	}
+#endif
+
+	// File class entries close themselves
+	entries.clear();
+	reads.clear();
+}
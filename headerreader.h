@@ -0,0 +1,94 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef HEADERREADER_H
+#define HEADERREADER_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "util.h"
+
+class IoRing;
+
+// Reads the headers of many small files with few system calls. Files are
+// added, then opened, read and closed as one batch each. On Linux every
+// step of a batch is submitted to io_uring at once, elsewhere or when the
+// kernel doesn't support it the File class is used for each file.
+class HeaderReader
+{
+public:
+	HeaderReader();
+	~HeaderReader();
+
+	// Copies don't share the io_uring, they set up their own when used
+	HeaderReader(const HeaderReader &other);
+
+	// Starts a new batch
+	void Begin();
+	size_t Add(const std::string &path);
+
+	// Adds length bytes at base of the file at path, such as an entry of a
+	// pak file. Offsets are relative to base and reads stop at its end.
+	size_t AddRange(const std::string &path, long base, size_t length);
+	void Open();
+	bool IsOpen(size_t file) const;
+
+	// Queues a read into data, which is resized to the number of bytes read
+	// once Read returns. data must stay valid until then.
+	void Queue(size_t file, long offset, size_t length, std::string &data);
+	void Read();
+
+	// Closes all files of the batch
+	void Close();
+
+private:
+	HeaderReader& operator=(const HeaderReader &other);
+
+	struct Entry
+	{
+		std::string path;
+		long base;
+		size_t limit;
+		int fd; // io_uring only
+		std::unique_ptr<File> file; // File class fallback only
+	};
+
+	struct ReadJob
+	{
+		size_t file;
+		long offset;
+		size_t length;
+		std::string *data;
+	};
+
+	bool UseRing();
+
+	std::vector<Entry> entries;
+	std::vector<ReadJob> reads;
+
+	std::unique_ptr<IoRing> ring; // NULL if io_uring isn't used
+	bool ringTried;
+};
+
+#endif // HEADERREADER_H
@@ -23,30 +23,63 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 //
 //////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <ctype.h>
+#include <functional>
 #include <stdio.h>
 #include <string.h>
 
 #ifdef _WIN32
 #include <windows.h>
-#else
-#include <sys/types.h>
-#include <dirent.h>
-#include <sys/stat.h>
-#include <unistd.h>
 #endif
 
+#include "dircache.h"
+#include "dirreader.h"
 #include "listbuilder.h"
 #include "util.h"
+#include "workqueue.h"
+
+// Half-Life BSP version
+#define BSPVERSION 30
+
+namespace
+{
+	// Shard of a map, from its path relative to the search folder. The hash
+	// is spelled out so every host and compiler agrees on the partition.
+	unsigned int GetMapShard(const std::string &relativepath, unsigned int shardcount)
+	{
+		// 32 bit FNV-1a
+		unsigned int hash = 2166136261U;
+
+		for (std::string::const_iterator it = relativepath.begin(); it != relativepath.end(); ++it)
+		{
+			char c = *it;
+			if (c == '\\')
+			{
+				c = '/';
+			}
+
+			hash ^= static_cast<unsigned int>(tolower(static_cast<unsigned char>(c)));
+			hash *= 16777619U;
+		}
+
+		return hash % shardcount + 1;
+	}
+}
 
 
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
 
-ListBuilder::ListBuilder(std::vector<std::string> *flist, std::vector<file_s> &excludes, bool beverbal, bool sdisp)
+ListBuilder::ListBuilder(std::vector<mapfile_s> *flist, std::vector<file_s> &excludes, bool beverbal, bool sdisp)
 	: exlist(excludes)
-	, firstdir(false)
 	, recursive(false)
+	, jobs(1)
+	, shard(1)
+	, shardcount(1)
+	, foundcount(0)
+	, cache(NULL)
 #ifndef _WIN32
 	, symlink(false)
 #endif
@@ -87,8 +120,9 @@ void ListBuilder::BuildList(std::vector<file_s> &srclist)
 
 		if (file.folder == false)
 		{
-			// single file processing
-			AddFile(file.name, false);
+			// single file processing, sharded by file name
+			const size_t separator = file.name.find_last_of("\\/");
+			AddFile(file.name, (separator == std::string::npos) ? 0 : separator + 1, false);
 		}
 		else
 		{
@@ -123,15 +157,34 @@ void ListBuilder::BuildList(std::vector<file_s> &srclist)
 				}
 			}
 
-			firstdir = true;
+			// Subdirectories are searched concurrently
+			{
+				WorkQueue queue(jobs);
+				queue.Add(std::bind(&ListBuilder::ListDir, this, std::ref(queue), file.name, true));
+				queue.Wait();
+			}
+
+			// Sort so the map list doesn't depend on directory or thread order
+			std::sort(foundMaps.begin(), foundMaps.end());
+
+			for (std::vector<std::string>::const_iterator it = foundMaps.begin(); it != foundMaps.end(); ++it)
+			{
+				AddFile(*it, file.name.length(), true);
+			}
 
-			ListDir(file.name);
+			foundMaps.clear();
 		}
 	}
 
 }
 
-void ListBuilder::AddFile(const std::string &filename, bool checkexlist)
+void ListBuilder::AddFoundMap(const std::string &filename, size_t rootlength)
+{
+	PrepExList();
+	AddFile(filename, rootlength, true);
+}
+
+void ListBuilder::AddFile(const std::string &filename, size_t rootlength, bool checkexlist)
 {
 #ifdef _DEBUG
 	if (filename.length() == 0)
@@ -182,8 +235,21 @@ void ListBuilder::AddFile(const std::string &filename, bool checkexlist)
 		}
 	}
 
-	// file can be added to filelist
-	filelist->push_back(tmp);
+	// file can be added to filelist, if it is in our shard
+	const size_t position = foundcount++;
+	if (shardcount > 1 && GetMapShard(tmp.substr(rootlength), shardcount) != shard)
+	{
+		return;
+	}
+
+	mapfile_s mapfile;
+	mapfile.name = tmp;
+	mapfile.position = position;
+
+	// Invalid maps stay in the list so they are reported, but are never parsed
+	mapfile.valid = ProbeBSP(mapfile);
+
+	filelist->push_back(mapfile);
 
 	if (verbal && searchdisp)
 	{
@@ -191,6 +257,51 @@ void ListBuilder::AddFile(const std::string &filename, bool checkexlist)
 	}
 }
 
+bool ListBuilder::ProbeBSP(mapfile_s &mapfile)
+{
+	const std::string &filename = mapfile.name;
+
+	mapfile.cost = 0;
+	mapfile.entities.fileofs = 0;
+	mapfile.entities.filelen = 0;
+	mapfile.textures = mapfile.entities;
+
+	// Only read the header, the lumps themselves are loaded when parsing
+	File bsp(filename, "rb");
+
+	if (bsp == NULL)
+	{
+		printf("Error opening \"%s\"\n", filename.c_str());
+		return false;
+	}
+
+	bsp_header header;
+
+	if (fread(&header, sizeof(bsp_header), 1, bsp) != 1)
+	{
+		printf("Error opening \"%s\". Corrupt BSP file.\n", filename.c_str());
+		return false;
+	}
+
+	if (header.version != BSPVERSION)
+	{
+		printf("Error opening \"%s\". Incorrect BSP version.\n", filename.c_str());
+		return false;
+	}
+
+	if (header.ent_header.fileofs <= 0)
+	{
+		printf("Error opening \"%s\". Corrupt BSP header.\n", filename.c_str());
+		return false;
+	}
+
+	mapfile.cost = static_cast<size_t>(header.ent_header.filelen) + header.tex_header.filelen;
+	mapfile.entities = header.ent_header;
+	mapfile.textures = header.tex_header;
+
+	return true;
+}
+
 void ListBuilder::PrepExList()
 {
 	// Prepares Exceptionlist by adding .bsp to filenames that need it
@@ -213,10 +324,31 @@ void ListBuilder::SetSymLink(bool slink)
 }
 #endif
 
+void ListBuilder::SetJobs(unsigned int jobcount)
+{
+	jobs = jobcount;
+}
+
+void ListBuilder::SetShard(unsigned int shardindex, unsigned int shards)
+{
+	shard = shardindex;
+	shardcount = shards;
+}
+
+void ListBuilder::SetCache(DirCache *dircache)
+{
+	cache = dircache;
+}
+
+size_t ListBuilder::GetFoundCount() const
+{
+	return foundcount;
+}
+
 
 #ifdef _WIN32
 // Win 32 DIR parser
-void ListBuilder::ListDir(const std::string &path)
+void ListBuilder::ListDir(WorkQueue &queue, const std::string &path, bool reporterror)
 {
 	WIN32_FIND_DATA filedata;
 
@@ -228,7 +360,7 @@ void ListBuilder::ListDir(const std::string &path)
 
 	if (filehandle == INVALID_HANDLE_VALUE)
 	{
-		if (firstdir)
+		if (reporterror)
 		{
 			if (GetLastError() & ERROR_PATH_NOT_FOUND || GetLastError() & ERROR_FILE_NOT_FOUND)
 			{
@@ -242,7 +374,7 @@ void ListBuilder::ListDir(const std::string &path)
 		return;
 	}
 
-	firstdir = false;
+	std::vector<std::string> maps;
 
 	do
 	{
@@ -257,7 +389,7 @@ void ListBuilder::ListDir(const std::string &path)
 				// Look for files in subdir, but ignore . and ..
 				if (strcmp(filedata.cFileName, ".") && strcmp(filedata.cFileName, ".."))
 				{
-					ListDir(file + "\\");
+					queue.Add(std::bind(&ListBuilder::ListDir, this, std::ref(queue), file + "\\", false));
 				}
 			}
 		}
@@ -266,7 +398,7 @@ void ListBuilder::ListDir(const std::string &path)
 			// Check if the file is a .bsp
 			if (!CompareStrEndNoCase(file, ".bsp"))
 			{
-				AddFile(file, true);
+				maps.push_back(file);
 			}
 		}
 
@@ -274,84 +406,84 @@ void ListBuilder::ListDir(const std::string &path)
 
 	// Close search
 	FindClose(filehandle);
+
+	std::lock_guard<std::mutex> lock(foundMapsMutex);
+	foundMaps.insert(foundMaps.end(), maps.begin(), maps.end());
 }
 
 #else
 // Linux dir parser
-void ListBuilder::ListDir(const std::string &path)
+void ListBuilder::ListDir(WorkQueue &queue, const std::string &path, bool reporterror)
 {
-	struct stat filestatinfo; // Force as a struct for GCC
+	// Symlinks change what is listed, so those walks are cached apart
+	const char * const section = symlink ? "maps" : "maps-nolinks";
+
+	// Directories that haven't changed since the last run aren't listed
+	DirCache::Listing entries;
+	dirstamp_s stamp;
+	const bool stamped = cache && DirCache::GetStamp(path, stamp);
 
-	// Open the current dir
-	DIR *directory = opendir(path.c_str());
-	// Is it open?
-	if (directory == NULL)
+	if (!stamped || !cache->Find(section, path, stamp, entries))
 	{
-		// dir cannot be opened
-		if (firstdir)
+		// Open the current dir, symlinks are only listed if we follow them
+		DirReader directory;
+		if (!directory.Open(path, symlink))
 		{
-			printf("There was an error with the directory you specified (%s)\nDid you enter the correct directory?\n", path.c_str());
+			// dir cannot be opened
+			if (reporterror)
+			{
+				printf("There was an error with the directory you specified (%s)\nDid you enter the correct directory?\n", path.c_str());
+			}
+			return;
 		}
-		return;
-	}
-
-	firstdir = false;
 
-	// Start going through dirs finding files.
-	while (true)
-	{
-		const dirent * const direntry = readdir(directory);
-		if(direntry == NULL)
+		// Start going through dirs finding files. Subdirectories are kept
+		// even if we don't recurse, so the cache works for -r too.
+		bool isdirectory;
+		while (const char * const name = directory.Next(isdirectory))
 		{
-			break;
+			// Check if the file is a .bsp
+			if (isdirectory || !CompareStrEndNoCase(name, ".bsp"))
+			{
+				direntry_s entry;
+				entry.type = isdirectory ? 'd' : 'f';
+				entry.name = name;
+				entry.offset = entry.length = 0;
+				entries.entries.push_back(entry);
+			}
 		}
 
-		// Do we have a dir?
-		std::string file = path + direntry->d_name;
-
-		int i;
+		// close the dir
+		directory.Close();
 
-		if (symlink)
-		{
-			i = stat(file.c_str(), &filestatinfo); // Get the info about the files the links point to
-		}
-		else
+		if (stamped)
 		{
-			i = lstat(file.c_str(), &filestatinfo); // Get the info about the links
+			entries.count = entries.entries.size();
+			cache->Store(section, path, stamp, entries);
 		}
+	}
 
-		if (i == 0)
+	std::vector<std::string> maps;
+
+	for (std::vector<direntry_s>::const_iterator it = entries.entries.begin(); it != entries.entries.end(); ++it)
+	{
+		// Do we have a dir?
+		if (it->type == 'd')
 		{
-			if (!S_ISLNK(filestatinfo.st_mode) || symlink)
+			// Should we process the directory?
+			if (recursive)
 			{
-				// Check for directory
-				if (S_ISDIR(filestatinfo.st_mode))
-				{
-					// Should we process the directory?
-					if (recursive)
-					{
-						// Look for files in subdir, but ignore . and ..
-						if (strcmp(direntry->d_name, ".") && strcmp(direntry->d_name, ".."))
-						{
-							ListDir(file + "/");
-						}
-					}
-				}
-				else
-				{
-					// Check if the file is a .bsp
-					if (!CompareStrEndNoCase(file, ".bsp"))
-					{
-						AddFile(file, true);
-					}
-				}
+				queue.Add(std::bind(&ListBuilder::ListDir, this, std::ref(queue), path + it->name + "/", false));
 			}
 		}
+		else
+		{
+			maps.push_back(path + it->name);
+		}
 	}
 
-	// close the dir
-	closedir(directory);
-
+	std::lock_guard<std::mutex> lock(foundMapsMutex);
+	foundMaps.insert(foundMaps.end(), maps.begin(), maps.end());
 }
 
 #endif
@@ -28,9 +28,13 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #pragma once
 
+#include <cstddef>
+#include <mutex>
 #include <string>
 #include <vector>
 
+#include "hltypes.h"
+
 struct file_s
 {
 	bool folder;
@@ -38,14 +42,35 @@ struct file_s
 	std::string name;
 };
 
+class DirCache;
+class WorkQueue;
+
+struct mapfile_s
+{
+	std::string name;
+	bool valid; // BSP header was read and has the right version
+	size_t cost; // Size of the entity and texture lumps, used for scheduling
+	size_t position; // Index in the map list before sharding
+	lumpinfo_s entities; // Lump locations, used for prefetching
+	lumpinfo_s textures;
+};
+
 class ListBuilder
 {
 public:
 #ifndef _WIN32
 	void SetSymLink(bool slink);
 #endif
+	void SetJobs(unsigned int jobcount);
+	void SetShard(unsigned int shardindex, unsigned int shards);
+	void SetCache(DirCache *dircache);
 	void BuildList(std::vector<file_s> &srclist);
-	ListBuilder(std::vector<std::string> *flist, std::vector<file_s> &excludes, bool beverbal, bool sdisp);
+
+	// A map found in a folder outside of BuildList, like BuildList would
+	// find it. rootlength is the length of the folder it was searched in.
+	void AddFoundMap(const std::string &filename, size_t rootlength);
+	size_t GetFoundCount() const; // Maps found before sharding
+	ListBuilder(std::vector<mapfile_s> *flist, std::vector<file_s> &excludes, bool beverbal, bool sdisp);
 	virtual ~ListBuilder();
 
 private:
@@ -53,17 +78,26 @@ private:
 	ListBuilder& operator=(const ListBuilder &other);
 
 	std::vector<file_s> & exlist;
-	bool firstdir;
-	void ListDir(const std::string &path);
+	void ListDir(WorkQueue &queue, const std::string &path, bool reporterror);
 	bool recursive;
+	unsigned int jobs;
+	unsigned int shard; // 1 based
+	unsigned int shardcount;
+	size_t foundcount;
+	DirCache *cache; // Unchanged directories aren't listed again if set
 #ifndef _WIN32
 	bool symlink;
 #endif
 	void PrepExList();
-	void AddFile(const std::string &filename, bool checkexlist);
+	void AddFile(const std::string &filename, size_t rootlength, bool checkexlist);
+	bool ProbeBSP(mapfile_s &mapfile);
 	bool searchdisp;
 	bool verbal;
-	std::vector<std::string> * filelist;
+	std::vector<mapfile_s> * filelist;
+
+	// Maps found by ListDir, in no particular order
+	std::vector<std::string> foundMaps;
+	std::mutex foundMapsMutex;
 };
 
 #endif // !defined(AFX_LISTBUILDER_H__EBF81BE5_23F6_426C_82E6_F5EB2AEDE98F__INCLUDED_)
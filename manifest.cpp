@@ -0,0 +1,431 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "manifest.h"
+#include "reswriter.h"
+#include "util.h"
+
+#define MANIFEST_HEADER "RESGen manifest 2"
+
+// Files changed this many seconds before the run started might change again
+// without getting a new modification time, maps that read them aren't stored
+#define MANIFEST_RACY 2
+
+namespace
+{
+	bool SameStamp(const dirstamp_s &a, const dirstamp_s &b)
+	{
+		return a.inode == b.inode && a.size == b.size && a.mtime == b.mtime && a.mtimensec == b.mtimensec;
+	}
+
+	// Paths and names are the rest of the line
+	bool HasNewline(const std::string &str)
+	{
+		return str.find_first_of("\r\n") != std::string::npos;
+	}
+
+	// The settings only have to be told apart from earlier ones
+	std::string Fingerprint(const std::string &settings)
+	{
+		std::string str;
+		appendFormat(str, "%016llx", hashData(settings.data(), settings.length()));
+		return str;
+	}
+
+	// <inode> <size> <mtime> <mtimensec>, followed by a single space
+	bool ParseStamp(const char *&fields, dirstamp_s &stamp)
+	{
+		int length = 0;
+		if (sscanf(fields, "%llu %llu %lld %ld%n", &stamp.inode, &stamp.size, &stamp.mtime, &stamp.mtimensec, &length) != 4
+			|| fields[length] != ' ')
+		{
+			return false;
+		}
+
+		fields += length + 1;
+		return true;
+	}
+
+	void AppendStamp(std::string &str, const dirstamp_s &stamp)
+	{
+		appendFormat(str, "%llu %llu %lld %ld ", stamp.inode, stamp.size, stamp.mtime, stamp.mtimensec);
+	}
+}
+
+Manifest::Manifest()
+	: started(static_cast<long long>(time(NULL)))
+{
+}
+
+bool Manifest::Load(const std::string &filename, const std::string &settings)
+{
+	records.clear();
+	fingerprint = Fingerprint(settings);
+
+	if (!fileExists(filename))
+	{
+		return true;
+	}
+
+	std::string str;
+	if (!readFile(filename, str))
+	{
+		printf("Error: Could not open manifest file %s!\n", filename.c_str());
+		return false;
+	}
+
+	Tokenizer<'\n'> tokenizer(str);
+	bool valid = true;
+	bool header = true;
+	bool ended = false;
+	bool sameSettings = false;
+	Record *record = NULL;
+
+	for (const char *token = tokenizer.Next(); token && valid; token = tokenizer.Next())
+	{
+		std::string line = token;
+		rightTrim(line, "\r");
+
+		const char *fields = line.c_str() + ((line.length() > 2) ? 2 : line.length());
+
+		if (header)
+		{
+			valid = (line == MANIFEST_HEADER);
+			header = false;
+		}
+		else if (line.empty())
+		{
+			continue;
+		}
+		else if (ended)
+		{
+			valid = false;
+		}
+		else if (line == "e")
+		{
+			// Written last, a file without it was cut short
+			ended = true;
+		}
+		else if (!line.compare(0, 2, "s "))
+		{
+			// s <fingerprint>
+			sameSettings = (fingerprint == fields);
+		}
+		else if (!line.compare(0, 2, "m "))
+		{
+			// m <status> <bsp stamp> <res exists> <res stamp> <map>
+			Record parsed;
+			int exists = 0;
+			int length = 0;
+
+			valid = sscanf(fields, "%d%n", &parsed.status, &length) == 1 && fields[length] == ' ';
+			fields += length + 1;
+
+			valid = valid && ParseStamp(fields, parsed.bsp)
+				&& sscanf(fields, "%d%n", &exists, &length) == 1 && fields[length] == ' ';
+			fields += length + 1;
+
+			valid = valid && ParseStamp(fields, parsed.res.stamp);
+
+			if (valid)
+			{
+				parsed.res.exists = (exists != 0);
+				parsed.visited = false;
+				parsed.updated = false;
+				record = &(records[fields] = parsed);
+			}
+		}
+		else if ((!line.compare(0, 2, "f ") || !line.compare(0, 2, "n ")) && record)
+		{
+			// f <stamp> <path> for files that existed, n <path> for others
+			Dependency dependency;
+			dependency.dependency.type = 'f';
+			dependency.file.exists = (line[0] == 'f');
+
+			valid = !dependency.file.exists || ParseStamp(fields, dependency.file.stamp);
+
+			if (valid)
+			{
+				dependency.dependency.name = fields;
+				record->dependencies.push_back(dependency);
+			}
+		}
+		else if ((!line.compare(0, 2, "r ") || !line.compare(0, 2, "x ")) && record)
+		{
+			// r <name on disk> for resources that were found, x <name> for others
+			Dependency dependency;
+			dependency.dependency.type = 'r';
+			dependency.file.exists = false;
+
+			if (line[0] == 'r')
+			{
+				dependency.dependency.found = fields;
+				dependency.dependency.name = strToLowerCopy(dependency.dependency.found);
+			}
+			else
+			{
+				dependency.dependency.name = fields;
+			}
+
+			record->dependencies.push_back(dependency);
+		}
+		else
+		{
+			valid = false;
+		}
+	}
+
+	if (!valid || header || !ended)
+	{
+		// Nothing is lost, every map is just processed again
+		printf("Warning: %s is not a valid RESGen manifest file, ignoring it.\n", filename.c_str());
+		records.clear();
+	}
+	else if (!sameSettings)
+	{
+		// Res files made with other settings may differ for every map
+		records.clear();
+	}
+
+	return true;
+}
+
+bool Manifest::Save(const std::string &filename) const
+{
+	std::string contents = MANIFEST_HEADER "\n";
+	appendFormat(contents, "s %s\n", fingerprint.c_str());
+
+	for (RecordMap::const_iterator it = records.begin(); it != records.end(); ++it)
+	{
+		const Record &record = it->second;
+
+		if (!record.visited && !fileExists(it->first))
+		{
+			// Map was removed
+			continue;
+		}
+
+		appendFormat(contents, "m %d ", record.status);
+		AppendStamp(contents, record.bsp);
+		appendFormat(contents, "%d ", record.res.exists ? 1 : 0);
+		AppendStamp(contents, record.res.exists ? record.res.stamp : dirstamp_s());
+		appendFormat(contents, "%s\n", it->first.c_str());
+
+		for (std::vector<Dependency>::const_iterator depIt = record.dependencies.begin(); depIt != record.dependencies.end(); ++depIt)
+		{
+			const dependency_s &dependency = depIt->dependency;
+
+			if (dependency.type == 'f' && depIt->file.exists)
+			{
+				contents += "f ";
+				AppendStamp(contents, depIt->file.stamp);
+				appendFormat(contents, "%s\n", dependency.name.c_str());
+			}
+			else if (dependency.type == 'f')
+			{
+				appendFormat(contents, "n %s\n", dependency.name.c_str());
+			}
+			else if (!dependency.found.empty())
+			{
+				appendFormat(contents, "r %s\n", dependency.found.c_str());
+			}
+			else
+			{
+				appendFormat(contents, "x %s\n", dependency.name.c_str());
+			}
+		}
+	}
+
+	contents += "e\n";
+
+	// Replaced in one step, like res files
+	std::string error;
+	if (!ResWriter::WriteResFile(filename, contents, error))
+	{
+		printf("Error: Could not write manifest file %s!\n", filename.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool Manifest::IsUpToDate(const std::string &map, const std::string &resName, const ResourceIndex &resources, int &status)
+{
+	Record record;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		RecordMap::iterator it = records.find(map);
+		if (it == records.end())
+		{
+			return false;
+		}
+
+		it->second.visited = true;
+		record = it->second;
+	}
+
+	// Maps that failed are never recorded
+	dirstamp_s bsp;
+	if (!DirCache::GetStamp(map, bsp) || !SameStamp(bsp, record.bsp))
+	{
+		return false;
+	}
+
+	// Res files that were removed or edited since are made again
+	dirstamp_s res;
+	const bool resExists = DirCache::GetStamp(resName, res);
+	if (resExists != record.res.exists || (resExists && !SameStamp(res, record.res.stamp)))
+	{
+		return false;
+	}
+
+	for (std::vector<Dependency>::const_iterator it = record.dependencies.begin(); it != record.dependencies.end(); ++it)
+	{
+		const dependency_s &dependency = it->dependency;
+
+		if (dependency.type == 'r')
+		{
+			// Missing resources that appeared, resources that disappeared,
+			// and resources of which the case changed for -m
+			const resource_s *resource = resources.Find(dependency.name);
+			if ((resource ? resource->name : std::string()) != dependency.found)
+			{
+				return false;
+			}
+		}
+		else
+		{
+			const FileStamp file = GetFileStamp(dependency.name);
+			if (file.exists != it->file.exists || (file.exists && !SameStamp(file.stamp, it->file.stamp)))
+			{
+				return false;
+			}
+		}
+	}
+
+	status = record.status;
+	return true;
+}
+
+void Manifest::Update(const std::string &map, const std::string &resName, int status, const std::vector<dependency_s> &dependencies)
+{
+	Record record;
+	record.status = status;
+	record.res.exists = false;
+	record.resName = resName;
+	record.visited = true;
+	record.updated = true;
+
+	bool valid = DirCache::GetStamp(map, record.bsp) && !IsRacy(record.bsp) && !HasNewline(map);
+
+	for (std::vector<dependency_s>::const_iterator it = dependencies.begin(); it != dependencies.end() && valid; ++it)
+	{
+		Dependency dependency;
+		dependency.dependency = *it;
+
+		if (it->type == 'f')
+		{
+			dependency.file = GetFileStamp(it->name);
+			valid = !(dependency.file.exists && IsRacy(dependency.file.stamp));
+		}
+		else
+		{
+			dependency.file.exists = false;
+		}
+
+		valid = valid && !HasNewline(it->name) && !HasNewline(it->found);
+		record.dependencies.push_back(dependency);
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (valid)
+	{
+		records[map] = record;
+	}
+	else
+	{
+		// Processed again next time
+		records.erase(map);
+	}
+}
+
+void Manifest::Forget(const std::string &map)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	records.erase(map);
+}
+
+void Manifest::EndRun()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (RecordMap::iterator it = records.begin(); it != records.end(); ++it)
+	{
+		Record &record = it->second;
+
+		if (record.updated)
+		{
+			// Written by now, or removed
+			record.res.exists = DirCache::GetStamp(record.resName, record.res.stamp);
+			record.updated = false;
+		}
+	}
+}
+
+void Manifest::BeginRun()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// Files may have changed since they were stamped
+	stamps.clear();
+	started = static_cast<long long>(time(NULL));
+}
+
+Manifest::FileStamp Manifest::GetFileStamp(const std::string &path)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		StampMap::const_iterator it = stamps.find(path);
+		if (it != stamps.end())
+		{
+			return it->second;
+		}
+	}
+
+	// Stat'ed without the lock, another thread may do the same file at once
+	FileStamp file;
+	file.exists = DirCache::GetStamp(path, file.stamp);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	stamps[path] = file;
+	return file;
+}
+
+bool Manifest::IsRacy(const dirstamp_s &stamp) const
+{
+	return stamp.mtime + MANIFEST_RACY >= started;
+}
@@ -0,0 +1,110 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "dircache.h"
+#include "resourceindex.h"
+
+// Input of a map other than the BSP and the settings
+struct dependency_s
+{
+	char type; // 'r' resource looked up in the resource list, 'f' file that was read
+	std::string name; // Resources: name in lowercase. Files: path.
+	std::string found; // Resources only: name on disk, empty if it was missing
+};
+
+// What every map processed by earlier runs depended on. A map only has to be
+// processed again if its BSP, its res file, one of the files it read or the
+// answer to one of its resource lookups changed since. Used by several
+// threads at once.
+class Manifest
+{
+public:
+	Manifest();
+
+	// A missing file, or one written with other settings, gives an empty manifest
+	bool Load(const std::string &filename, const std::string &settings);
+	bool Save(const std::string &filename) const;
+
+	// status is set to the result of the run that recorded the map
+	bool IsUpToDate(const std::string &map, const std::string &resName, const ResourceIndex &resources, int &status);
+
+	// Records a map after processing, its res file is stamped by EndRun
+	void Update(const std::string &map, const std::string &resName, int status, const std::vector<dependency_s> &dependencies);
+
+	// For maps that failed, even after Update
+	void Forget(const std::string &map);
+
+	// Stamps the res files of the maps updated since the last call, once
+	// they have been written
+	void EndRun();
+
+	// Files changed before now can be trusted, for runs that keep going
+	void BeginRun();
+
+private:
+	Manifest(const Manifest &other);
+	Manifest& operator=(const Manifest &other);
+
+	struct FileStamp
+	{
+		bool exists;
+		dirstamp_s stamp; // Only if it exists
+	};
+
+	struct Dependency
+	{
+		dependency_s dependency;
+		FileStamp file; // Files only
+	};
+
+	struct Record
+	{
+		int status;
+		dirstamp_s bsp;
+		FileStamp res;
+		std::string resName;
+		std::vector<Dependency> dependencies;
+		bool visited; // Checked or updated by this run
+		bool updated; // Res file has to be stamped by EndRun
+	};
+	typedef std::map<std::string, Record> RecordMap;
+	typedef std::map<std::string, FileStamp> StampMap;
+
+	FileStamp GetFileStamp(const std::string &path);
+	bool IsRacy(const dirstamp_s &stamp) const;
+
+	RecordMap records; // By map path
+	StampMap stamps; // Files read by maps, stamped once per run
+	std::string fingerprint; // Of the settings
+	long long started; // Time this run started
+	std::mutex mutex;
+};
+
+#endif // MANIFEST_H
@@ -0,0 +1,365 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <algorithm>
+#include <stdio.h>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "mapprocessor.h"
+
+MapProcessor::MapProcessor(const config_s &config, const RESGen &resgen)
+	: prototype(resgen)
+	, jobs(config.jobs)
+	, prefetchDepth(config.prefetch)
+	, prefetchTextures(config.parseresource && !config.resource_path.empty())
+	, verbal(config.verbal)
+	, contentdisp(config.contentdisp)
+	, syncWrites(config.fsync)
+	, maplist(NULL)
+	, resourceList(NULL)
+	, resultList(NULL)
+	, resWriter(NULL)
+	, nextGroup(0)
+	, nextOutput(0)
+{
+}
+
+void MapProcessor::ProcessMaps(const std::vector<mapfile_s> &maps, const ResourceIndex &resources, std::vector<int> &results)
+{
+	// Maps that failed the header probe are errors, they were reported already
+	results.assign(maps.size(), 0);
+	for (size_t i = 0; i < maps.size(); i++)
+	{
+		if (!maps[i].valid)
+		{
+			results[i] = 1;
+		}
+	}
+
+	maplist = &maps;
+	resourceList = &resources;
+	resultList = &results;
+
+	// Res files are written on a separate thread
+	ResWriter writer(64, syncWrites);
+	resWriter = &writer;
+
+	size_t workerCount = jobs;
+	if (workerCount > maps.size())
+	{
+		// No use in starting workers that won't get a map
+		workerCount = maps.size();
+	}
+
+	if (workerCount <= 1)
+	{
+		// Serial processing, print straight to the console
+		RESGen worker(prototype);
+
+		// Like the workers do, wait for the res file of an earlier map with
+		// the same res file to be written before checking if it exists
+		outputDone.assign(maps.size(), false);
+		GroupAliasedMaps();
+
+		std::vector<bool> aliased(maps.size(), false);
+		for (std::vector<std::vector<size_t> >::const_iterator it = mapGroups.begin(); it != mapGroups.end(); ++it)
+		{
+			for (size_t i = 1; i < it->size(); i++)
+			{
+				aliased[(*it)[i]] = true;
+			}
+		}
+
+		for (size_t i = 0; i < prefetchDepth && i < maps.size(); i++)
+		{
+			PrefetchMap(i);
+		}
+
+		for (size_t i = 0; i < maps.size(); i++)
+		{
+			if (i + prefetchDepth < maps.size())
+			{
+				PrefetchMap(i + prefetchDepth);
+			}
+
+			if (aliased[i])
+			{
+				resWriter->Wait();
+			}
+
+			if (maps[i].valid)
+			{
+				results[i] = ProcessMap(worker, i, NULL);
+			}
+		}
+
+		ReportWriteFailures();
+		return;
+	}
+
+	nextGroup = 0;
+	nextOutput = 0;
+	pendingOutput.assign(maps.size(), std::string());
+	outputDone.assign(maps.size(), false);
+
+	GroupAliasedMaps();
+	SortGroupsByCost();
+
+	if (workerCount > mapGroups.size())
+	{
+		workerCount = mapGroups.size();
+	}
+
+	// Every worker prefetches the group prefetchDepth places after the one it
+	// takes, so the first groups have to be prefetched here
+	for (size_t i = 0; i < prefetchDepth && i < mapGroups.size(); i++)
+	{
+		PrefetchGroup(i);
+	}
+
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < workerCount; i++)
+	{
+		workers.push_back(std::thread(&MapProcessor::RunWorker, this));
+	}
+
+	for (std::vector<std::thread>::iterator it = workers.begin(); it != workers.end(); ++it)
+	{
+		it->join();
+	}
+
+	ReportWriteFailures();
+}
+
+void MapProcessor::ReportWriteFailures()
+{
+	resWriter->Wait();
+
+	std::vector<ResWriter::Failure> failures = resWriter->GetFailures();
+
+	// Report in map list order
+	std::vector<std::string> messages(maplist->size());
+	for (std::vector<ResWriter::Failure>::const_iterator it = failures.begin(); it != failures.end(); ++it)
+	{
+		const size_t index = static_cast<size_t>(it->id - 1);
+		messages[index] += it->message;
+		(*resultList)[index] = 1;
+	}
+
+	for (std::vector<std::string>::const_iterator it = messages.begin(); it != messages.end(); ++it)
+	{
+		printf("%s", it->c_str());
+	}
+
+	resWriter = NULL;
+}
+
+void MapProcessor::GroupAliasedMaps()
+{
+	mapGroups.clear();
+
+	std::map<std::string, size_t> groupIndices;
+
+	for (size_t i = 0; i < maplist->size(); i++)
+	{
+		if (!(*maplist)[i].valid)
+		{
+			// Never processed, so its output is done
+			outputDone[i] = true;
+			continue;
+		}
+
+		std::string basefolder;
+		std::string basefilename;
+		splitPath((*maplist)[i].name, basefolder, basefilename);
+
+		const std::string resKey = GetCanonicalPath(basefolder) + PATH_SEPARATOR + basefilename;
+
+		std::map<std::string, size_t>::const_iterator it = groupIndices.find(resKey);
+		if (it == groupIndices.end())
+		{
+			groupIndices[resKey] = mapGroups.size();
+			mapGroups.push_back(std::vector<size_t>(1, i));
+		}
+		else
+		{
+			mapGroups[it->second].push_back(i);
+		}
+	}
+}
+
+namespace
+{
+	struct GroupCostGreater
+	{
+		GroupCostGreater(const std::vector<mapfile_s> &maps_)
+			: maps(maps_)
+		{
+		}
+
+		size_t Cost(const std::vector<size_t> &group) const
+		{
+			size_t cost = 0;
+			for (std::vector<size_t>::const_iterator it = group.begin(); it != group.end(); ++it)
+			{
+				cost += maps[*it].cost;
+			}
+			return cost;
+		}
+
+		bool operator()(const std::vector<size_t> &a, const std::vector<size_t> &b) const
+		{
+			return Cost(a) > Cost(b);
+		}
+
+		const std::vector<mapfile_s> &maps;
+	};
+}
+
+void MapProcessor::SortGroupsByCost()
+{
+	// Start with the largest maps, so a big map at the end of the list can't
+	// keep one worker busy while the others are idle. Stable, so equal maps
+	// keep their map list order.
+	std::stable_sort(mapGroups.begin(), mapGroups.end(), GroupCostGreater(*maplist));
+}
+
+void MapProcessor::RunWorker()
+{
+	// Each worker has its own RESGen, so resfile and texturelist are private
+	RESGen worker(prototype);
+	std::string output;
+
+	// while(true) incorrectly triggers MSVC C4127
+	for(;;)
+	{
+		const size_t group = nextGroup++;
+
+		if (group >= mapGroups.size())
+		{
+			break;
+		}
+
+		if (group + prefetchDepth < mapGroups.size())
+		{
+			PrefetchGroup(group + prefetchDepth);
+		}
+
+		for (std::vector<size_t>::const_iterator it = mapGroups[group].begin(); it != mapGroups[group].end(); ++it)
+		{
+			if (it != mapGroups[group].begin())
+			{
+				// Same res file as the previous map, which has to be on disk
+				// before this map checks if it exists
+				resWriter->Wait();
+			}
+
+			(*resultList)[*it] = ProcessMap(worker, *it, &output);
+
+			FlushOutput(*it, output);
+		}
+	}
+}
+
+void MapProcessor::PrefetchMap(size_t index) const
+{
+	const mapfile_s &mapfile = (*maplist)[index];
+
+	if (!mapfile.valid)
+	{
+		return;
+	}
+
+#ifndef _WIN32
+	// Have the kernel read the lumps MakeRES needs into the page cache in the
+	// background, so the reads don't block once the map is processed
+	const int fd = open(mapfile.name.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		// Not fatal, MakeRES will report it
+		return;
+	}
+
+	posix_fadvise(fd, mapfile.entities.fileofs, mapfile.entities.filelen, POSIX_FADV_WILLNEED);
+
+	if (prefetchTextures)
+	{
+		posix_fadvise(fd, mapfile.textures.fileofs, mapfile.textures.filelen, POSIX_FADV_WILLNEED);
+	}
+
+	close(fd);
+#endif
+}
+
+void MapProcessor::PrefetchGroup(size_t group) const
+{
+	for (std::vector<size_t>::const_iterator it = mapGroups[group].begin(); it != mapGroups[group].end(); ++it)
+	{
+		PrefetchMap(*it);
+	}
+}
+
+int MapProcessor::ProcessMap(RESGen &worker, size_t index, std::string *output)
+{
+	worker.SetOutputBuffer(output);
+	worker.SetResWriter(resWriter);
+
+	if (contentdisp)
+	{
+		// Make output look a bit cleaner
+		if (output) { output->append("\n"); } else { printf("\n"); }
+	}
+
+	std::string map((*maplist)[index].name);
+	const int retval = worker.MakeRES(map, static_cast<int>(index + 1), maplist->size(), *resourceList);
+
+	if (verbal)
+	{
+		// Make output look a bit cleaner
+		if (output) { output->append("\n"); } else { printf("\n"); }
+	}
+
+	return retval;
+}
+
+void MapProcessor::FlushOutput(size_t index, std::string &output)
+{
+	std::lock_guard<std::mutex> lock(outputMutex);
+
+	pendingOutput[index].swap(output);
+	outputDone[index] = true;
+
+	// Print the output of all maps that are next in line
+	while (nextOutput < outputDone.size() && outputDone[nextOutput])
+	{
+		fputs(pendingOutput[nextOutput].c_str(), stdout);
+
+		// Release the memory, this map is done
+		std::string().swap(pendingOutput[nextOutput]);
+
+		nextOutput++;
+	}
+}
@@ -0,0 +1,89 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef MAPPROCESSOR_H
+#define MAPPROCESSOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "listbuilder.h"
+#include "resgenclass.h"
+#include "reswriter.h"
+#include "util.h"
+
+// Runs RESGen::MakeRES over a list of maps, optionally on several threads.
+// Every worker gets its own copy of the configured RESGen, so per-map state
+// is never shared. Console output of each map is buffered and printed in map
+// list order, so it is the same as that of a serial run.
+class MapProcessor
+{
+public:
+	MapProcessor(const config_s &config, const RESGen &resgen);
+
+	// Stores the MakeRES return value of maps[i] in results[i]. Maps that
+	// failed the BSP header probe are marked as failed without parsing them.
+	void ProcessMaps(const std::vector<mapfile_s> &maps, const ResourceIndex &resources, std::vector<int> &results);
+
+private:
+	MapProcessor(const MapProcessor &other);
+	MapProcessor& operator=(const MapProcessor &other);
+
+	void GroupAliasedMaps();
+	void SortGroupsByCost();
+	void RunWorker();
+	void PrefetchMap(size_t index) const;
+	void PrefetchGroup(size_t group) const;
+	void ReportWriteFailures();
+	int ProcessMap(RESGen &worker, size_t index, std::string *output);
+	void FlushOutput(size_t index, std::string &output);
+
+	const RESGen &prototype;
+	unsigned int jobs;
+	unsigned int prefetchDepth;
+	bool prefetchTextures;
+	bool verbal;
+	bool contentdisp;
+	bool syncWrites;
+
+	// State of the current ProcessMaps call, shared by all workers
+	const std::vector<mapfile_s> *maplist;
+	const ResourceIndex *resourceList;
+	std::vector<int> *resultList;
+	ResWriter *resWriter;
+
+	// Maps that share a res file (e.g. found through a symlink) end up in the
+	// same group, which is processed by one worker in map list order.
+	// The most expensive groups are handed out first.
+	std::vector<std::vector<size_t> > mapGroups;
+	std::atomic<size_t> nextGroup;
+
+	std::mutex outputMutex;
+	std::vector<std::string> pendingOutput;
+	std::vector<bool> outputDone;
+	size_t nextOutput;
+};
+
+#endif
@@ -0,0 +1,214 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <algorithm>
+#include <ctype.h>
+#include <functional>
+
+#include "namelist.h"
+#include "util.h"
+
+// Smallest table, always a power of two
+#define NAMELIST_SLOTS 256
+
+NameList::NameList()
+	: used(0), size(0), sorted(true), generation(1)
+{
+}
+
+void NameList::Clear()
+{
+	used = 0;
+	size = 0;
+	order.clear();
+	sorted = true;
+
+	// Slots of earlier generations are empty
+	if (++generation == 0)
+	{
+		Slot empty = { 0, 0 };
+		std::fill(slots.begin(), slots.end(), empty);
+		generation = 1;
+	}
+}
+
+void NameList::Add(const std::string &name)
+{
+	Add(name.data(), name.length());
+}
+
+void NameList::Add(const char *name, size_t length)
+{
+	if ((used + 1) * 2 > slots.size())
+	{
+		// Kept at most half full, so probes stay short
+		Grow();
+	}
+
+	const uint32_t hash = hashStringNoCase(name, length);
+	const size_t slot = FindSlot(name, length, hash);
+
+	if (slots[slot].generation == generation)
+	{
+		Entry &entry = entries[slots[slot].index];
+		entry.name.assign(name, length);
+
+		if (entry.erased)
+		{
+			// Back in its old place
+			entry.erased = false;
+			size++;
+		}
+		return;
+	}
+
+	if (used == entries.size())
+	{
+		entries.push_back(Entry());
+	}
+
+	// The strings of an entry used by an earlier map keep their memory
+	Entry &entry = entries[used];
+	entry.name.assign(name, length);
+	entry.nameLower.assign(name, length);
+	strToLower(entry.nameLower);
+	entry.hash = hash;
+	entry.erased = false;
+
+	slots[slot].generation = generation;
+	slots[slot].index = static_cast<uint32_t>(used);
+
+	order.push_back(static_cast<uint32_t>(used));
+	sorted = false;
+	used++;
+	size++;
+}
+
+bool NameList::Contains(const std::string &name) const
+{
+	if (slots.empty())
+	{
+		return false;
+	}
+
+	const size_t slot = FindSlot(name.data(), name.length(), hashStringNoCase(name.data(), name.length()));
+	return slots[slot].generation == generation && !entries[slots[slot].index].erased;
+}
+
+size_t NameList::Size() const
+{
+	return size;
+}
+
+bool NameList::Empty() const
+{
+	return size == 0;
+}
+
+void NameList::Sort()
+{
+	if (!sorted)
+	{
+		std::sort(order.begin(), order.end(), std::bind(&NameList::IndexLess, this, std::placeholders::_1, std::placeholders::_2));
+		sorted = true;
+	}
+}
+
+size_t NameList::Count() const
+{
+	return order.size();
+}
+
+const NameList::Entry &NameList::operator[](size_t position) const
+{
+	return entries[order[position]];
+}
+
+void NameList::SetName(size_t position, const std::string &name)
+{
+	entries[order[position]].name = name;
+}
+
+void NameList::Erase(size_t position)
+{
+	Entry &entry = entries[order[position]];
+
+	if (!entry.erased)
+	{
+		entry.erased = true;
+		size--;
+	}
+}
+
+bool NameList::IndexLess(uint32_t a, uint32_t b) const
+{
+	return entries[a].nameLower < entries[b].nameLower;
+}
+
+size_t NameList::FindSlot(const char *name, size_t length, uint32_t hash) const
+{
+	const size_t mask = slots.size() - 1;
+	size_t slot = hash & mask;
+
+	for (; slots[slot].generation == generation; slot = (slot + 1) & mask)
+	{
+		const Entry &entry = entries[slots[slot].index];
+		if (entry.hash != hash || entry.nameLower.length() != length)
+		{
+			continue;
+		}
+
+		size_t i = 0;
+		while (i < length && entry.nameLower[i] == static_cast<char>(tolower(static_cast<unsigned char>(name[i]))))
+		{
+			i++;
+		}
+
+		if (i == length)
+		{
+			break;
+		}
+	}
+
+	// The name, or the empty slot it would go in
+	return slot;
+}
+
+void NameList::Grow()
+{
+	std::vector<Slot> grown(std::max(static_cast<size_t>(NAMELIST_SLOTS), slots.size() * 2));
+	const size_t mask = grown.size() - 1;
+
+	// Erased names stay in the table, so adding one again finds its place
+	for (size_t index = 0; index < used; index++)
+	{
+		size_t slot = entries[index].hash & mask;
+		while (grown[slot].generation == generation)
+		{
+			slot = (slot + 1) & mask;
+		}
+
+		grown[slot].generation = generation;
+		grown[slot].index = static_cast<uint32_t>(index);
+	}
+
+	slots.swap(grown);
+}
@@ -0,0 +1,96 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef NAMELIST_H
+#define NAMELIST_H
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Names collected for one map, by lowercase name, with the case of the last
+// one added. A RESGen handles one map after another, so nothing is freed
+// between maps: Clear() only rewinds, keeping the entries and the memory of
+// their strings for the next map, and empties the table of names by starting
+// a new generation of it. Once the first maps have been handled, collecting
+// the names of a map allocates nothing.
+//
+// Names are kept in the order they were added until Sort() is called. Erased
+// names keep their place, so positions stay valid while going through them.
+class NameList
+{
+public:
+	struct Entry
+	{
+		std::string name;
+		std::string nameLower;
+		uint32_t hash; // Of nameLower
+		bool erased;
+	};
+
+	NameList();
+
+	void Clear();
+
+	// Replaces the case of a name that is in the list already
+	void Add(const std::string &name);
+	void Add(const char *name, size_t length);
+
+	// Name in any case, erased names aren't in the list
+	bool Contains(const std::string &name) const;
+
+	// Names that aren't erased
+	size_t Size() const;
+	bool Empty() const;
+
+	// Sorts by lowercase name. Needed before going through the names in
+	// order after names were added.
+	void Sort();
+
+	// Positions go up to Count(), erased names included
+	size_t Count() const;
+	const Entry &operator[](size_t position) const;
+	void SetName(size_t position, const std::string &name);
+	void Erase(size_t position);
+
+private:
+	struct Slot
+	{
+		uint32_t generation; // Empty unless it is the current generation
+		uint32_t index; // Index in entries
+	};
+
+	bool IndexLess(uint32_t a, uint32_t b) const;
+
+	size_t FindSlot(const char *name, size_t length, uint32_t hash) const;
+	void Grow();
+
+	std::vector<Entry> entries; // Only the first used are in the list
+	size_t used;
+	size_t size;
+	std::vector<uint32_t> order; // Indices in entries, by position
+	bool sorted;
+	std::vector<Slot> slots;
+	uint32_t generation;
+};
+
+#endif // NAMELIST_H
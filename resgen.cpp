@@ -49,6 +49,19 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 -k *WIN32* do not wait for keypress before exit
 -t *LINUX* ignore symbolic links when searching directories
 
+-J [jobs] number of maps to process in parallel, or 'auto' for all CPUs
+-P [maps] number of maps to read ahead while processing (default 4)
+
+--shard [i/N] only process maps in shard i of N (1 based)
+--summary [file] write the run summary to [file]
+--merge [file] combine shard summaries into one report (repeatable)
+--fsync sync res files to disk before replacing existing ones
+--cache [file] only list folders changed since the run that wrote [file]
+--incremental [file] only process maps whose inputs changed since the run that wrote [file]
+--assets [file] only parse WADs and MDLs changed since the run that wrote [file] (use with -u)
+--results [folder] reuse resource lists of maps parsed before, [folder] may be shared
+--watch *LINUX* keep running and process maps again as they or their resources change
+
 // v1 -> v2 command line changes:
 -w -> [CHANGE] Win32 exit mode to warranty
 -i -> [OS] Not Linux specific anymore
@@ -67,6 +80,19 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 -n do not ignore unused wads (use with -u)
 
+// v2.0.3 -> v2.1 command line changes:
+-J -> [NEW] Process maps in parallel
+-P -> [NEW] Read ahead maps
+--shard -> [NEW] Split work between processes or hosts
+--summary -> [NEW] To go with --shard
+--merge -> [NEW] To go with --summary
+--fsync -> [NEW] Safe res file replacement on filesystems that need it
+--cache -> [NEW] Skip listing folders that didn't change
+--incremental -> [NEW] Skip maps whose inputs didn't change
+--assets -> [NEW] To go with -u, skip parsing WADs and MDLs that didn't change
+--results -> [NEW] Share resource lists of maps between runs
+--watch -> [NEW] *LINUX* Process maps and resources as they change
+
 // Param usage
 abcdefghijklmnopqrstuvwxyz
 xxxxxxxxxxxxx xx xxxxxxx
@@ -87,11 +113,18 @@ xxxxxxxxxxxxx xx xxxxxxx
 #include <windows.h>
 #endif
 
+#include "assetstore.h"
+#include "dircache.h"
 #include "listbuilder.h"
+#include "manifest.h"
+#include "mapprocessor.h"
 #include "resgenclass.h"
 #include "resgen.h"
 #include "resourcelistbuilder.h"
+#include "resultcache.h"
+#include "summary.h"
 #include "util.h"
+#include "watcher.h"
 
 #ifdef _WIN32
 void getexitkey(bool verbal, bool keypress)
@@ -147,6 +180,21 @@ void showhelp()
 	printf(" -n           Do not ignore unused WAD files (use with -u)\n");
 
 	printf(" -b [rfafile] Excludes resources from [rfafile] from generated res files.\n");
+	printf(" -J [jobs]    Process [jobs] maps in parallel, 'auto' uses all available CPUs\n");
+	printf(" -P [maps]    Read ahead [maps] maps while processing (default 4, 0 disables)\n");
+
+	printf(" --shard [i/N]    Only process the maps in shard i of N\n");
+	printf(" --summary [file] Write a summary of the run to [file]\n");
+	printf(" --merge [file]   Report on the summaries of all shards (repeatable)\n");
+	printf(" --fsync          Sync res files to disk before replacing existing ones\n");
+	printf(" --cache [file]   Only list folders that changed since the last run\n");
+	printf(" --incremental [file] Only process maps that changed since the last run\n");
+	printf(" --assets [file]  Only parse WAD and MDL files that changed since the last run\n");
+	printf(" --results [folder] Reuse the resource lists of maps parsed before\n");
+
+	#ifdef __linux__
+	printf(" --watch          Keep running, process maps and resources as they change\n");
+	#endif
 
 	#ifdef _WIN32
 	printf(" -k           RESGen will not wait for a keypress to exit in verbal mode\n");
@@ -196,6 +244,92 @@ void showcredits()
 	printf("http://resgen.hltools.com\n");
 }
 
+void showsummary(const summary_s &summary, bool verbal)
+{
+	size_t errorcount = summary.errors.size();
+	size_t missingcount = summary.missing.size();
+	if (errorcount)
+	{
+		if (verbal)
+		{
+			printf("Failed to create res file(s) for:\n");
+			for (std::vector<mapresult_s>::const_iterator it = summary.errors.begin(); it != summary.errors.end(); ++it)
+			{
+				printf(" %s\n", it->name.c_str());
+			}
+			printf("\n");
+		}
+	}
+	if (missingcount)
+	{
+		// res file might not be complete
+		if (verbal)
+		{
+			printf("Because one or more required files were not found in your installation,\n");
+			printf("the following map(s) might be missing resources:\n");
+			for (std::vector<mapresult_s>::const_iterator it = summary.missing.begin(); it != summary.missing.end(); ++it)
+			{
+				printf(" %s\n", it->name.c_str());
+			}
+			printf("\n");
+		}
+	}
+
+	printf("Done creating res file(s)! " SIZE_T_SPECIFIER " map(s) were processed", summary.mapcount - errorcount);
+	if (errorcount)
+	{
+		printf(", skipped " SIZE_T_SPECIFIER " due to errors.\n", errorcount);
+	}
+	else
+	{
+		printf(".\n");
+	}
+
+	if (missingcount)
+	{
+		printf(SIZE_T_SPECIFIER " map(s) might be missing resources.\n", missingcount);
+	}
+}
+
+// Everything besides the maps and resources that changes the res files. Must
+// be called once the names of the rfa file and exclude lists are resolved.
+// Fails if one of them can't be read, its contents are unknown then.
+bool describesettings(const config_s &config, std::string &settings)
+{
+	settings = VERSION "\n";
+
+	appendFormat(settings, "%d%d%d%d%d\n",
+		config.tolower, config.matchcase, config.checkpak, config.parseresource, config.preservewads);
+	settings += config.resource_path + "\n";
+
+	// Contents too, so an edited list is noticed
+	std::string contents;
+	if (!config.rfafile.empty())
+	{
+		if (!readFile(config.rfafile, contents))
+		{
+			return false;
+		}
+
+		appendFormat(settings, "a " SIZE_T_SPECIFIER " %s\n", contents.length(), config.rfafile.c_str());
+		settings += contents + "\n";
+	}
+
+	for (std::vector<std::string>::const_iterator it = config.excludelists.begin(); it != config.excludelists.end(); ++it)
+	{
+		contents.clear();
+		if (!readFile(*it, contents))
+		{
+			return false;
+		}
+
+		appendFormat(settings, "b " SIZE_T_SPECIFIER " %s\n", contents.length(), it->c_str());
+		settings += contents + "\n";
+	}
+
+	return true;
+}
+
 int main(int argc, char* argv[])
 {
 	// init config struct
@@ -219,6 +353,15 @@ int main(int argc, char* argv[])
 	config.parseresource = false;
 	config.preservewads = false;
 
+	config.jobs = 1;
+	config.prefetch = 4;
+
+	config.shard = 1;
+	config.shardcount = 1;
+
+	config.fsync = false;
+	config.watch = false;
+
 #ifdef _WIN32
 	config.keypress = true;
 #else
@@ -229,7 +372,85 @@ int main(int argc, char* argv[])
 	for (int i = 1; i < argc; i++) // arg 0 is the command line.
 	{
 		char *argstr = argv[i];
-		if (argstr[0] == '-')
+		if (argstr[0] == '-' && argstr[1] == '-')
+		{
+			// long switches, all but --fsync and --watch take one value
+// --fsync
+			if (!strcmp(argstr, "--fsync"))
+			{
+				config.fsync = true;
+			}
+// --watch
+			else if (!strcmp(argstr, "--watch"))
+			{
+#ifdef __linux__
+				config.watch = true;
+#else
+				printf("Ignoring '--watch' argument: Only supported on Linux\n");
+#endif
+			}
+			else if (i == argc - 1 || argv[i+1][0] == '-')
+			{
+				printf ("Ignoring '%s' argument: No value specified\n", argstr);
+			}
+// --shard
+			else if (!strcmp(argstr, "--shard"))
+			{
+				char *end;
+				const long shard = strtol(argv[i+1], &end, 10);
+				const long shardcount = (*end == '/') ? strtol(end + 1, &end, 10) : 0;
+				if (*end != 0 || shard < 1 || shard > shardcount)
+				{
+					printf ("Ignoring '--shard' argument: Shard must be i/N, with i from 1 to N\n");
+					continue;
+				}
+
+				i++; // increase i.. we used that arg.
+				config.shard = static_cast<unsigned int>(shard);
+				config.shardcount = static_cast<unsigned int>(shardcount);
+			}
+// --summary
+			else if (!strcmp(argstr, "--summary"))
+			{
+				i++; // increase i.. we used that arg.
+				config.summaryfile = argv[i];
+			}
+// --merge
+			else if (!strcmp(argstr, "--merge"))
+			{
+				i++; // increase i.. we used that arg.
+				config.mergefiles.push_back(argv[i]);
+			}
+// --cache
+			else if (!strcmp(argstr, "--cache"))
+			{
+				i++; // increase i.. we used that arg.
+				config.cachefile = argv[i];
+			}
+// --incremental
+			else if (!strcmp(argstr, "--incremental"))
+			{
+				i++; // increase i.. we used that arg.
+				config.manifestfile = argv[i];
+			}
+// --assets
+			else if (!strcmp(argstr, "--assets"))
+			{
+				i++; // increase i.. we used that arg.
+				config.assetfile = argv[i];
+			}
+// --results
+			else if (!strcmp(argstr, "--results"))
+			{
+				i++; // increase i.. we used that arg.
+				config.resultfolder = argv[i];
+			}
+			else
+			{
+				printf("Ignoring '%s' argument: Argument not known\n", argstr);
+			}
+		}
+		else if (argstr[0] == '-')
 		{
 			// cmdline switch(es)
 			size_t arglen = strlen(argstr);
@@ -482,6 +703,69 @@ int main(int argc, char* argv[])
 					i++; // increase i.. we used that arg.
 					config.excludelists.push_back(argv[i]);
 					break;
+// -J
+				case 'J':
+				{
+#ifdef NO_MULTIARG_FILES
+					if (arglen != 2)
+					{
+						printf ("Ignoring 'J' argument: Cannot be used in multiple argument list\n");
+						break;
+					}
+#endif
+					if (i == argc - 1)
+					{
+						printf ("Ignoring 'J' argument: No job count specified\n");
+						break;
+					}
+
+					if (!strcmp(argv[i+1], "auto"))
+					{
+						config.jobs = 0; // Determined after parsing
+						i++; // increase i.. we used that arg.
+						break;
+					}
+
+					char *end;
+					const long jobs = strtol(argv[i+1], &end, 10);
+					if (*end != 0 || jobs < 1)
+					{
+						printf ("Ignoring 'J' argument: Job count must be a positive number or 'auto'\n");
+						break;
+					}
+
+					i++; // increase i.. we used that arg.
+					config.jobs = static_cast<unsigned int>(jobs);
+					break;
+				}
+// -P
+				case 'P':
+				{
+#ifdef NO_MULTIARG_FILES
+					if (arglen != 2)
+					{
+						printf ("Ignoring 'P' argument: Cannot be used in multiple argument list\n");
+						break;
+					}
+#endif
+					if (i == argc - 1)
+					{
+						printf ("Ignoring 'P' argument: No map count specified\n");
+						break;
+					}
+
+					char *end;
+					const long depth = strtol(argv[i+1], &end, 10);
+					if (*end != 0 || depth < 0)
+					{
+						printf ("Ignoring 'P' argument: Map count must be a number\n");
+						break;
+					}
+
+					i++; // increase i.. we used that arg.
+					config.prefetch = static_cast<unsigned int>(depth);
+					break;
+				}
 #ifdef _WIN32
 // -k
 				case 'k':
@@ -520,6 +804,17 @@ int main(int argc, char* argv[])
 		config.contentdisp = false;
 	}
 
+	if (config.jobs == 0)
+	{
+		config.jobs = GetAvailableCpuCount();
+	}
+
+	// The status line can only show a single map
+	if (config.jobs > 1)
+	{
+		config.statusline = false;
+	}
+
 	// check for stuff to display
 	if (config.warranty)
 	{
@@ -553,6 +848,31 @@ int main(int argc, char* argv[])
 		exit(0);
 	}
 
+	// combining the summaries of earlier runs doesn't process any maps
+	if (!config.mergefiles.empty())
+	{
+		if (!config.files.empty())
+		{
+			printf("Ignoring maps and folders: Only merging summaries\n");
+		}
+
+		summary_s summary;
+		if (MergeSummaries(config.mergefiles, summary))
+		{
+			if (!config.summaryfile.empty())
+			{
+				WriteSummary(config.summaryfile, summary);
+			}
+
+			showsummary(summary, config.verbal);
+		}
+
+#ifdef _WIN32
+		getexitkey(config.verbal, config.keypress);
+#endif
+		return 0;
+	}
+
 	// check if we have anything to do
 	if (config.files.empty())
 	{
@@ -570,17 +890,45 @@ int main(int argc, char* argv[])
 		printf("Generating RES files. Please stand by...\n");
 	}
 
+	// Folders that didn't change since the last run aren't listed again
+	DirCache dircache;
+	DirCache *cache = NULL;
+
+	if (!config.cachefile.empty())
+	{
+		dircache.Load(config.cachefile);
+		cache = &dircache;
+	}
+
 	// Build filelist
-	std::vector<std::string> FileList; // bsp files
-	std::vector<std::string> ErrorList; // failed bsp files
-	std::vector<std::string> MissingList; // bsp files with missing reources
+	std::vector<mapfile_s> FileList; // bsp files
+	std::vector<int> ResultList; // MakeRES results for FileList
 
 	ListBuilder listbuild(&FileList, config.excludes, config.verbal, config.searchdisp);
+	listbuild.SetCache(cache);
 #ifndef _WIN32
 	listbuild.SetSymLink(config.symlink);
 #endif
+	listbuild.SetJobs(config.jobs);
+	listbuild.SetShard(config.shard, config.shardcount);
 	listbuild.BuildList(config.files);
 
+	if (config.verbal && config.shardcount > 1)
+	{
+		printf("Processing shard %u/%u: " SIZE_T_SPECIFIER " of " SIZE_T_SPECIFIER " map(s).\n",
+			config.shard, config.shardcount, FileList.size(), listbuild.GetFoundCount());
+	}
+
+	// Watching needs them to know which new maps to process
+	std::vector<file_s> watchFiles;
+	std::vector<file_s> watchExcludes;
+
+	if (config.watch)
+	{
+		watchFiles.swap(config.files);
+		watchExcludes.swap(config.excludes);
+	}
+
 	// clean up config.files, we don't need it anymore
 	config.files.clear();
 
@@ -596,6 +944,9 @@ int main(int argc, char* argv[])
 		config.verbal, config.statusline, config.overwrite, config.tolower,
 		config.matchcase, config.parseresource, config.preservewads, config.contentdisp);
 
+	// Maps uploaded while watching may be cut short while they are parsed
+	resgen.SetMapsMayChange(config.watch);
+
 	if(!resgen.LoadRfaFile(config.rfafile))
 	{
 		// Could not load RFA file, exit
@@ -605,6 +956,33 @@ int main(int argc, char* argv[])
 		return 0;
 	}
 
+	// WAD and MDL files that didn't change since the last run aren't parsed
+	AssetStore assetstore;
+
+	if (!config.assetfile.empty())
+	{
+		assetstore.Load(config.assetfile);
+		resgen.SetAssetStore(&assetstore);
+	}
+
+	// Maps with the same entities as a map parsed before aren't parsed again.
+	// Only -l changes what parsing finds.
+	std::string resultSettings = VERSION;
+	appendFormat(resultSettings, " %d", config.tolower);
+	ResultCache resultcache(config.resultfolder, resultSettings);
+
+	if (!config.resultfolder.empty())
+	{
+		if (fileExists(config.resultfolder))
+		{
+			resgen.SetResultCache(&resultcache);
+		}
+		else
+		{
+			printf("Ignoring '--results' argument: Folder %s does not exist\n", config.resultfolder.c_str());
+		}
+	}
+
 	// Load all resource exclude lists
 	if (!config.excludelists.empty())
 	{
@@ -630,11 +1008,31 @@ int main(int argc, char* argv[])
 			}
 		}
 
-		config.excludelists.clear();
-
 		if (config.verbal) { printf("\n"); }
 	}
 
+	// Maps that didn't change since the last run are skipped
+	Manifest manifest;
+
+	if (!config.manifestfile.empty())
+	{
+		// A list that can't be read counts as changed settings, every map is
+		// processed again
+		std::string settings;
+		if (describesettings(config, settings))
+		{
+			manifest.Load(config.manifestfile, settings);
+		}
+	}
+
+	if (!config.manifestfile.empty() || config.watch)
+	{
+		// Watching uses it to find the maps that depend on changed resources
+		resgen.SetManifest(&manifest);
+	}
+
+	config.excludelists.clear();
+
 	std::vector<std::string> resourcePaths;
 
 	if (!config.resource_path.empty())
@@ -646,82 +1044,89 @@ int main(int argc, char* argv[])
 	}
 
 	ResourceListBuilder resourceListBuilder(config);
+	resourceListBuilder.SetCache(cache);
 	resourceListBuilder.BuildResourceList(resourcePaths, config.checkpak, config.resourcedisp);
 
-	int i = 1;
-	size_t filecount = FileList.size();
-	while (FileList.size() > 0)
+	if (cache)
 	{
-		if (config.contentdisp) { printf("\n"); } // Make output look a bit cleaner
+		cache->Save(config.cachefile);
+	}
 
-		std::string map(FileList[0]);
-		int retval = resgen.MakeRES(map, i, filecount, resourceListBuilder.resources, resourcePaths);
-		if(retval)
-		{
-			if (retval == 2)
-			{
-				// res file was made properly, but some resources were missing
-				MissingList.push_back(FileList[0]);
-			}
-			else
-			{
-				//
-				// an error occured. List them.
-				ErrorList.push_back(FileList[0]);
-			}
-		}
+	if (config.verbal && config.jobs > 1)
+	{
+		printf("Processing maps using %u parallel jobs.\n\n", config.jobs);
+	}
 
-		FileList.erase(FileList.begin());
+	size_t filecount = FileList.size();
 
-		if (config.verbal) { printf("\n"); } // Make output look a bit cleaner
+	MapProcessor mapProcessor(config, resgen);
+	mapProcessor.ProcessMaps(FileList, resourceListBuilder.resources, ResultList);
 
-		i++; // keep i up to date!
-	}
+	// Results are in FileList order, whatever order the maps were processed in
+	summary_s summary;
+	summary.shard = config.shard;
+	summary.shardcount = config.shardcount;
+	summary.totalmaps = listbuild.GetFoundCount();
+	summary.mapcount = filecount;
 
-	// clean up errors
-	size_t errorcount = ErrorList.size();
-	size_t missingcount = MissingList.size();
-	if (errorcount)
+	for (size_t i = 0; i < filecount; i++)
 	{
-		if (config.verbal) { printf("Failed to create res file(s) for:\n"); }
-		while (!ErrorList.empty())
+		mapresult_s result;
+		result.position = FileList[i].position;
+		result.name = FileList[i].name;
+
+		if (ResultList[i] == 1 && !config.manifestfile.empty())
 		{
-			std::string strtmp = ErrorList[0];
-			if (config.verbal) { printf(" %s\n", strtmp.c_str()); } // only print of verbal
-			ErrorList.erase(ErrorList.begin());
+			// Failed maps are always processed again
+			manifest.Forget(result.name);
 		}
-		if (config.verbal) { printf("\n"); }
-	}
-	if (missingcount)
-	{
-		// res file might not be complete
-		if (config.verbal) {
-			printf("Because one or more required files were not found in your installation,\n");
-			printf("the following map(s) might be missing resources:\n");
+
+		if (ResultList[i] == 2)
+		{
+			// res file was made properly, but some resources were missing
+			summary.missing.push_back(result);
 		}
-		while (!MissingList.empty())
+		else if (ResultList[i])
 		{
-			std::string strtmp = MissingList[0];
-			if (config.verbal) { printf(" %s\n", strtmp.c_str()); } // only print of verbal
-			MissingList.erase(MissingList.begin());
+			//
+			// an error occured. List them.
+			summary.errors.push_back(result);
 		}
-		if (config.verbal) { printf("\n"); }
 	}
 
-	printf("Done creating res file(s)! " SIZE_T_SPECIFIER " map(s) were processed", filecount - errorcount);
-	if (errorcount)
+	// Kept when watching, maps are processed again as they change
+	if (!config.watch)
 	{
-		printf(", skipped " SIZE_T_SPECIFIER " due to errors.\n", errorcount);
+		FileList.clear();
 	}
-	else
+
+	manifest.EndRun();
+
+	if (!config.manifestfile.empty())
 	{
-		printf(".\n");
+		manifest.Save(config.manifestfile);
 	}
 
-	if (missingcount)
+	if (!config.assetfile.empty())
 	{
-		printf(SIZE_T_SPECIFIER " map(s) might be missing resources.\n", missingcount);
+		assetstore.Save(config.assetfile);
+	}
+
+	if (!config.summaryfile.empty())
+	{
+		WriteSummary(config.summaryfile, summary);
 	}
+
+	showsummary(summary, config.verbal);
+
+#ifdef __linux__
+	if (config.watch)
+	{
+		Watcher watcher(config, resgen, manifest, assetstore, cache);
+		watcher.Run(watchFiles, watchExcludes, resourcePaths, FileList, resourceListBuilder.resources);
+	}
+#endif
+
 	// res files made.. exit
 
 	// note we don't bother to clean up memory, the OS will do this for us.
@@ -25,6 +25,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #define VERSION "2.0.3"
 #endif
 
+#include <string>
 #include <vector>
 
 void getexitkey(bool verbal, bool keypress);
@@ -34,4 +35,10 @@ void showhelp();
 void showwarranty();
 void showcredits();
 
+struct summary_s;
+void showsummary(const summary_s &summary, bool verbal);
+
+struct config_s;
+bool describesettings(const config_s &config, std::string &settings);
+
 int main(int argc, char* argv[]);
@@ -26,7 +26,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 // RESGen does it's own security checks, no need to add VS2005's layer
 #define _CRT_SECURE_NO_DEPRECATE
 
+#include <algorithm>
 #include <assert.h>
+#include <functional>
+#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
@@ -41,11 +44,14 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <unistd.h>
 #endif
 
+#include "bspfile.h"
 #include "enttokenizer.h"
+#include "headerreader.h"
 #include "hltypes.h"
 #include "resgenclass.h"
 #include "resgen.h"
 #include "resourcelistbuilder.h"
+#include "reswriter.h"
 #include "util.h"
 
 // Half-Life BSP version
@@ -55,6 +61,38 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 // The higher the number, the less excess statbar writing, but also makes the statbar 'lag'
 #define STAT_MAX 15
 
+// Larger WAD lump tables aren't read in one go by PrefetchHeaders
+#define MAX_PREFETCH_LUMPS 65536
+
+namespace
+{
+	// Files that belong to a map by name, e.g. overviews/<map>.txt. A rule
+	// adds all of its files, but only if every one of them exists.
+	struct companion_s
+	{
+		const char *folder; // Relative to the mod folder
+		const char *suffixes[3]; // Appended to the map name, NULL terminated
+		bool alternative; // Only tried if the rule before it didn't apply
+	};
+
+	const companion_s companions[] =
+	{
+		// Overview info needs the overview image as well
+		{ "overviews/", { ".txt", ".tga", NULL }, false },
+		{ "overviews/", { ".txt", ".bmp", NULL }, true },
+		// Detail texture list
+		{ "maps/", { "_detail.txt", NULL, NULL }, false },
+		// Map briefing
+		{ "maps/", { ".txt", NULL, NULL }, false },
+	};
+
+	// Tells apart the WADs and MDLs of one pak file in the asset store
+	uint32_t AssetOffset(const resource_s &resource)
+	{
+		return (resource.pak >= 0) ? resource.offset : 0;
+	}
+}
+
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
@@ -73,8 +111,16 @@ std::vector<std::string>::iterator findStringNoCase(std::vector<std::string> &ve
 }
 
 RESGen::RESGen()
+	: wadcache(new WadCache)
 {
 	checkforexcludes = false;
+	mapsMayChange = false;
+	resourceIndex = NULL;
+	manifest = NULL;
+	assets = NULL;
+	resultcache = NULL;
+	output = NULL;
+	reswriter = NULL;
 }
 
 RESGen::~RESGen()
@@ -93,9 +139,54 @@ void RESGen::SetParams(bool beverbal, bool statline, bool overwrt, bool lcase, b
 	contentdisp = cdisp;
 }
 
-int RESGen::MakeRES(std::string &map, int fileindex, size_t filecount, const StringMap &resources, std::vector<std::string> &resourcePaths_)
+void RESGen::SetOutputBuffer(std::string *buffer)
+{
+	output = buffer;
+}
+
+void RESGen::SetResWriter(ResWriter *writer)
 {
-	resourcePaths = resourcePaths_;
+	reswriter = writer;
+}
+
+void RESGen::SetManifest(Manifest *incremental)
+{
+	manifest = incremental;
+}
+
+void RESGen::SetAssetStore(AssetStore *store)
+{
+	assets = store;
+}
+
+void RESGen::SetResultCache(const ResultCache *cache)
+{
+	resultcache = cache;
+}
+
+void RESGen::SetMapsMayChange(bool mayChange)
+{
+	mapsMayChange = mayChange;
+}
+
+void RESGen::BeginRun(bool resourcesChanged)
+{
+	if (resourcesChanged)
+	{
+		// Copies made from now on share a new cache
+		wadcache.reset(new WadCache);
+		wadtextures.clear();
+	}
+
+	if (assets)
+	{
+		assets->BeginRun();
+	}
+}
+
+int RESGen::MakeRES(std::string &map, int fileindex, size_t filecount, const ResourceIndex &resources)
+{
+	resourceIndex = &resources;
 
 	std::string basefolder;
 	std::string basefilename;
@@ -105,7 +196,7 @@ int RESGen::MakeRES(std::string &map, int fileindex, size_t filecount, const Str
 
 	if (verbal)
 	{
-		printf("Creating .res file %s [%d/" SIZE_T_SPECIFIER "].\n", resName.c_str(), fileindex, filecount);
+		Print("Creating .res file %s [%d/" SIZE_T_SPECIFIER "].\n", resName.c_str(), fileindex, filecount);
 	}
 
 
@@ -115,29 +206,312 @@ int RESGen::MakeRES(std::string &map, int fileindex, size_t filecount, const Str
 	if (!overwrite && fileexists)
 	{
 		// File found, but we don't want to overwrite.
-		printf("%s already exists. Skipping file.\n", resName.c_str());
+		Print("%s already exists. Skipping file.\n", resName.c_str());
 		return 1;
 	}
 
+	if (manifest)
+	{
+		int status;
+		if (manifest->IsUpToDate(map, resName, resources, status))
+		{
+			if (verbal)
+			{
+				Print("Nothing changed since the last run. Skipping file.\n");
+			}
+			return status;
+		}
+
+		dependencies.clear();
+	}
+
 	// Clear the resfile list to be sure (SHOULD be empty)
-	resfile.clear();
+	resfile.Clear();
 
 	// Clear the texture list to be sure (SHOULD be empty)
-	texturelist.clear();
+	texturelist.Clear();
 
-	// first, get the enity data
-	std::string entdata;
+	// first, get the enity data. It is parsed straight from the mapped, or read, file.
+	BspFile bsp;
+	const char *entdata;
+	size_t entlength;
 
-	if(!LoadBSPData(map, entdata, texturelist))
+	if(!LoadBSPData(map, bsp, entdata, entlength, texturelist))
 	{
 		// error. return
 		return 1;
 	}
 
+	// Textures missing from every WAD are listed in order
+	texturelist.Sort();
+
+	// Maps parsed before, by this or another run, aren't parsed again
+	std::string resultKey;
+	if (resultcache)
+	{
+		resultKey = resultcache->MakeKey(entdata, entlength);
+	}
 
+	if (!resultcache || !resultcache->Find(resultKey, resfile))
+	{
+		if (!ParseEntities(map, entdata, entlength, fileindex, filecount))
+		{
+			return 1;
+		}
+
+		if (resultcache)
+		{
+			resultcache->Store(resultKey, resfile);
+		}
+	}
+	else if (contentdisp)
+	{
+		// Report the files parsing would have found, in the order it found
+		// them. A file found more than once is only reported once.
+		for (size_t i = 0; i < resfile.Count(); i++)
+		{
+			Print("\r%-21s\n", resfile[i].name.c_str());
+		}
+	}
+
+	if (statusline)
+	{
+		// erase statusline
+		Print("\r%-21s\r", ""); // easier to adjust length this way
+	}
+
+	bsp.Close();
+
+	// Try to find overview data and other files named after the map
+	AddCompanionFiles(basefolder, basefilename);
+
+	// Resources are checked and written in order of their lowercase name
+	resfile.Sort();
+
+	// Resource list has been made.
+	int status = 0; // RES status, 0 means ok, 2 means missing resource
+
+	std::vector<std::string> extraResources;
+
+	// Check for resources on disk
+	if (resources.HasRoots())
+	{
+		if (parseresource)
+		{
+			// Read all WAD and MDL headers the check needs as one batch
+			PrefetchHeaders();
+		}
+
+		//Print("\nStarting resource check:\n");
+		for (size_t i = 0; i < resfile.Count(); i++)
+		{
+			const NameList::Entry &entry = resfile[i];
+			bool bErase = false;
+
+			const resource_s *resource = FindResource(entry.nameLower);
+
+			if(resource == NULL)
+			{
+				// file not found - maybe it's excluded?
+				if(excludelist.find(entry.nameLower) != excludelist.end())
+				{
+					// file found - it's an exclude
+					if (contentdisp)
+					{
+						Print("Resource is excluded: %s\n", entry.name.c_str());
+					}
+
+				}
+				else if (CompareStrEnd(entry.nameLower, ".wad"))
+				{
+					// not a wad file
+					if (verbal)
+					{
+						Print("Resource file not found: %s\n", entry.name.c_str());
+					}
+					status = 2; // res file might not be complete
+				}
+				else
+				{
+					// wad file is not critical, so no status change
+					if (contentdisp)
+					{
+						Print("Resource file not found: %s\n", entry.name.c_str());
+					}
+				}
+
+				bErase = true;
+			}
+			else
+			{
+				if (matchcase)
+				{
+					// match case
+					resfile.SetName(i, resource->name);
+				}
+
+				if (parseresource)
+				{
+					if (!CompareStrEnd(entry.nameLower, ".wad"))
+					{
+						// Check if wad file is used
+						if (!CheckWadUse(entry.nameLower, *resource)) // We MUST have the right file
+						{
+							// Wad is NOT being used
+							if (contentdisp)
+							{
+								Print("WAD file not used: %s\n", entry.name.c_str());
+							}
+
+							if(!preservewads)
+							{
+								bErase = true;
+							}
+						}
+					}
+					else if (!CompareStrEnd(entry.nameLower, ".mdl"))
+					{
+						// Check model for external texture
+						if (CheckModelExtTexture(*resource))
+						{
+							// Uses external texture, add
+							std::string extmdltex = entry.name.substr(0, entry.name.length() - 4); // strip extention
+							extmdltex += "T.mdl"; // add T and extention
+
+							if(
+								!resfile.Contains(extmdltex)
+							&&	(findStringNoCase(extraResources, extmdltex) == extraResources.end())
+							)
+							{
+								extraResources.push_back(extmdltex);
+
+								if (contentdisp)
+								{
+									Print("MDL texture file added: %s\n", extmdltex.c_str());
+								}
+							}
+						}
+					}
+
+				}
+			}
+
+			if(bErase)
+			{
+				resfile.Erase(i);
+			}
+		}
+
+		for(std::vector<std::string>::const_iterator extraIt = extraResources.begin(); extraIt != extraResources.end(); ++extraIt)
+		{
+			resfile.Add(*extraIt);
+		}
+
+		resfile.Sort();
+
+		prefetched.clear();
+	}
+
+	// Check if resource has to be excluded
+	if (checkforexcludes)
+	{
+		//Print("\nStarting exclude check:\n");
+		for (size_t i = 0; i < resfile.Count(); i++)
+		{
+			const NameList::Entry &entry = resfile[i];
+
+			if(!entry.erased && excludelist.find(entry.nameLower) != excludelist.end())
+			{
+				// file found
+				if (contentdisp)
+				{
+					Print("Resource is excluded: %s\n", entry.name.c_str());
+				}
+
+				resfile.Erase(i);
+			}
+		}
+	}
+
+	// Give a list of missing textures
+	if (parseresource && resources.HasRoots() && verbal)
+	{
+		if (!texturelist.Empty())
+		{
+			status = 2; // res file might not be complete
+			for (size_t i = 0; i < texturelist.Count(); i++)
+			{
+				if (!texturelist[i].erased)
+				{
+					Print("Texture not found in wad files: %s\n", texturelist[i].name.c_str());
+				}
+			}
+		}
+	}
+
+	if (resfile.Empty() && rfastring.empty())
+	{
+		// no resources!
+		if (verbal) { Print("No resources were found for \"%s.res\".", basefilename.c_str()); }
+
+		if (fileexists)
+		{
+			// File exists, delete it.
+			// WHAT? No check for overwrite? No!
+			// Think of it, if the file exists we MUST be in overwrite mode to even get to this point!
+			if (reswriter)
+			{
+				reswriter->Remove(resName);
+			}
+			else
+			{
+				remove(resName.c_str());
+			}
+
+			if (verbal)
+			{
+				Print(" Deleting existing res file.\n");
+			}
+		}
+		else
+		{
+			// File doesn't exist, so we don't have to delete it.
+			if (verbal)
+			{
+				Print(" Skipping file.\n");
+			}
+		}
+
+		if (manifest)
+		{
+			manifest->Update(map, resName, status, dependencies);
+		}
+		return status;
+	}
+
+	// Collecting resfile entries is done, now write the res file.
+	if (!WriteRes(basefolder, basefilename, fileindex))
+	{
+		return 1;
+	}
+
+	// File written successfully. We can safely erase the resfile and texture list
+	resfile.Clear();
+	texturelist.Clear();
+
+	if (manifest)
+	{
+		manifest->Update(map, resName, status, dependencies);
+	}
+
+	return status;
+}
+
+bool RESGen::ParseEntities(const std::string &map, const char *entdata, size_t entlength, int fileindex, size_t filecount)
+{
 	statcount = STAT_MAX; // make statbar print at once
 
-	EntTokenizer entDataTokenizer(entdata);
+	EntTokenizer entDataTokenizer(entdata, entlength);
 
 	
 	try
@@ -147,15 +521,15 @@ int RESGen::MakeRES(std::string &map, int fileindex, size_t filecount, const Str
 		// Note that we reparse the mapinfo.
 		if(!kv)
 		{
-			printf("Error parsing \"%s\".\n", map.c_str());
-			return 1;
+			Print("Error parsing \"%s\".\n", map.c_str());
+			return false;
 		}
 
 		while (kv && (entDataTokenizer.GetNumBlocksRead() == 0))
 		{
-			if (!strcmp(kv->first, "wad"))
+			if (entDataTokenizer.KeyIs("wad"))
 			{
-				std::string value(kv->second);
+				std::string value(kv->second, static_cast<size_t>(entDataTokenizer.GetLatestValueLength()));
 				if (!value.empty()) // Don't try to parse an empty listing
 				{
 					// seperate the WAD files and save
@@ -177,9 +551,9 @@ int RESGen::MakeRES(std::string &map, int fileindex, size_t filecount, const Str
 				}
 
 			}
-			else if (!strcmp(kv->first, "skyname"))
+			else if (entDataTokenizer.KeyIs("skyname"))
 			{
-				std::string value(kv->second);
+				std::string value(kv->second, static_cast<size_t>(entDataTokenizer.GetLatestValueLength()));
 
 				// Add al 6 sky textures here
 				AddRes(value, "gfx/env/", "up.tga");
@@ -201,7 +575,7 @@ int RESGen::MakeRES(std::string &map, int fileindex, size_t filecount, const Str
 			// Early out - check if key ends in 'speak'
 			if(
 				(keyLength >= 5)
-			&&	!strcmp(kv->first + keyLength - 5, "speak")
+			&&	!memcmp(kv->first + keyLength - 5, "speak", 5)
 			)
 			{
 				// Guessing which keys have spoken sentences is too likely to
@@ -210,19 +584,20 @@ int RESGen::MakeRES(std::string &map, int fileindex, size_t filecount, const Str
 				// TODO: This can still cause false positives if used on a different entity/mod
 				// TODO: Ideally parse FGD corresponding to map
 				if(
-					!strcmp(kv->first, "AP_speak")
-				||	!strcmp(kv->first, "non_owners_team_speak")
-				||	!strcmp(kv->first, "non_team_speak")
-				||	!strcmp(kv->first, "owners_team_speak")
-				||	!strcmp(kv->first, "speak")
-				||	!strcmp(kv->first, "team_speak")
+					entDataTokenizer.KeyIs("AP_speak")
+				||	entDataTokenizer.KeyIs("non_owners_team_speak")
+				||	entDataTokenizer.KeyIs("non_team_speak")
+				||	entDataTokenizer.KeyIs("owners_team_speak")
+				||	entDataTokenizer.KeyIs("speak")
+				||	entDataTokenizer.KeyIs("team_speak")
 				)
 				{
-					ParseSentence(kv->second);
+					ParseSentence(kv->second, static_cast<size_t>(valueLength));
 				}
 			}
 
 			const char *token = kv->second;
+			const size_t tokenLength = static_cast<size_t>(valueLength);
 
 			// TODO: This is fast, but should be made more robust if possible
 			// Need at least 5 chars, assuming filename is:
@@ -238,383 +613,173 @@ int RESGen::MakeRES(std::string &map, int fileindex, size_t filecount, const Str
 					if(c1 == 'm' && c2 == 'd' && c3 == 'l')
 					{
 						// mdl file
-						AddRes(token);
+						AddRes(std::string(token, tokenLength));
 					}
 					if(c1 == 'w' && c2 == 'a' && c3 == 'v')
 					{
 						// wave file
-						AddRes(token, "sound/");
+						AddRes(std::string(token, tokenLength), "sound/");
 					}
 					if(c1 == 's' && c2 == 'p' && c3 == 'r')
 					{
 						// sprite file
-						AddRes(token);
+						AddRes(std::string(token, tokenLength));
 					}
 					if(c1 == 'b' && c2 == 'm' && c3 == 'p')
 					{
 						// bitmap file
-						AddRes(token);
-					}
-					if(c1 == 't' && c2 == 'g' && c3 == 'a')
-					{
-						// targa file
-						AddRes(token);
-					}
-				}
-			}
-
-			// update statbar
-			if (statusline && statcount == STAT_MAX)
-			{
-				// Reset the statcount
-				statcount = 0;
-
-				// Calculate the percentage completed of the current file.
-				size_t progress = static_cast<size_t>(token - &entdata[0]);
-				size_t percentage = ((progress + 1) * 101) / entdata.length(); // Make the length one too long.
-				if (percentage > 100)
-				{
-					 // Make sure we don;t go over 100%
-					percentage = 100;
-				}
-				printf("\r(" SIZE_T_SPECIFIER "%%) [%d/" SIZE_T_SPECIFIER "]", percentage, fileindex, filecount);
-			}
-			else
-			{
-				statcount++;
-			}
-
-			kv = entDataTokenizer.NextPair();
-		}
-	}
-	catch(ParseException &parseException)
-	{
-		if(parseException.GetCharNum() >= 0)
-		{
-			printf("Failed to parse '%s': %s (char: %d)\n", map.c_str(), parseException.what(), parseException.GetCharNum());
-		}
-		else
-		{
-			printf("Failed to parse '%s': %s\n", map.c_str(), parseException.what());
-		}
-		return 1;
-	}
-
-	if (statusline)
-	{
-		// erase statusline
-		printf("\r%-21s\r", ""); // easier to adjust length this way
-	}
-
-	entdata.clear();
-
-	// Try to find info txt and overview data
-	std::string overviewPath = basefolder + ".." + PATH_SEPARATOR + "overviews" + PATH_SEPARATOR + basefilename;
-	if(fileExists(overviewPath + ".txt"))
-	{
-		// file found, but we need the tga or bmp too
-		if(fileExists(overviewPath + ".tga"))
-		{
-			// txt found too, add both files to res list
-			AddRes(basefilename, "overviews/", ".tga");
-			AddRes(basefilename, "overviews/", ".txt");
-		}
-		else if(fileExists(overviewPath + ".bmp"))
-		{
-			// txt found too, add both files to res list
-			AddRes(basefilename, "overviews/", ".bmp");
-			AddRes(basefilename, "overviews/", ".txt");
-		}
-	}
-
-	// Resource list has been made.
-	int status = 0; // RES status, 0 means ok, 2 means missing resource
-
-	std::vector<std::string> extraResources;
-
-	// Check for resources on disk
-	if (!resourcePaths.empty())
-	{
-		//printf("\nStarting resource check:\n");
-		StringMap::iterator it = resfile.begin();
-
-		while(it != resfile.end())
-		{
-			bool bErase = false;
-
-			StringMap::const_iterator resourceIt = resources.find(it->first);
-
-			if(resourceIt == resources.end())
-			{
-				// file not found - maybe it's excluded?
-				if(excludelist.find(it->first) != excludelist.end())
-				{
-					// file found - it's an exclude
-					if (contentdisp)
-					{
-						printf("Resource is excluded: %s\n", it->second.c_str());
-					}
-
-				}
-				else if (CompareStrEnd(it->first, ".wad"))
-				{
-					// not a wad file
-					if (verbal)
-					{
-						printf("Resource file not found: %s\n", it->second.c_str());
-					}
-					status = 2; // res file might not be complete
-				}
-				else
-				{
-					// wad file is not critical, so no status change
-					if (contentdisp)
-					{
-						printf("Resource file not found: %s\n", it->second.c_str());
-					}
-				}
-
-				bErase = true;
-			}
-			else
-			{
-				if (matchcase)
-				{
-					// match case
-					it->second = resourceIt->second;
-				}
-
-				if (parseresource)
-				{
-					if (!CompareStrEnd(it->first, ".wad"))
-					{
-						// Check if wad file is used
-						if (!CheckWadUse(resourceIt)) // We MUST have the right file
-						{
-							// Wad is NOT being used
-							if (contentdisp)
-							{
-								printf("WAD file not used: %s\n", it->second.c_str());
-							}
-
-							if(!preservewads)
-							{
-								bErase = true;
-							}
-						}
-					}
-					else if (!CompareStrEnd(it->first, ".mdl"))
-					{
-						// Check model for external texture
-						if (CheckModelExtTexture(resourceIt->second))
-						{
-							// Uses external texture, add
-							std::string extmdltex = it->second.substr(0, it->second.length() - 4); // strip extention
-							extmdltex += "T.mdl"; // add T and extention
-
-							if(
-								(resfile.find(strToLowerCopy(extmdltex)) == resfile.end())
-							&&	(findStringNoCase(extraResources, extmdltex) == extraResources.end())
-							)
-							{
-								extraResources.push_back(extmdltex);
-
-								if (contentdisp)
-								{
-									printf("MDL texture file added: %s\n", extmdltex.c_str());
-								}
-							}
-						}
+						AddRes(std::string(token, tokenLength));
+					}
+					if(c1 == 't' && c2 == 'g' && c3 == 'a')
+					{
+						// targa file
+						AddRes(std::string(token, tokenLength));
 					}
-
 				}
 			}
 
-			if(bErase)
-			{
-				it = resfile.erase(it);
-			}
-			else
+			// update statbar
+			if (statusline && statcount == STAT_MAX)
 			{
-				++it;
-			}
-		}
-
-		for(std::vector<std::string>::const_iterator extraIt = extraResources.begin(); extraIt != extraResources.end(); ++extraIt)
-		{
-			resfile[strToLowerCopy(*extraIt)] = *extraIt;
-		}
-	}
+				// Reset the statcount
+				statcount = 0;
 
-	// Check if resource has to be excluded
-	if (checkforexcludes)
-	{
-		//printf("\nStarting exclude check:\n");
-		StringMap::iterator it = resfile.begin();
-		while(it != resfile.end())
-		{
-			if(excludelist.find(it->first) != excludelist.end())
-			{
-				// file found
-				if (contentdisp)
+				// Calculate the percentage completed of the current file.
+				size_t progress = static_cast<size_t>(token - entdata);
+				size_t percentage = ((progress + 1) * 101) / entlength; // Make the length one too long.
+				if (percentage > 100)
 				{
-					printf("Resource is excluded: %s\n", it->second.c_str());
+					 // Make sure we don;t go over 100%
+					percentage = 100;
 				}
-
-				it = resfile.erase(it);
+				Print("\r(" SIZE_T_SPECIFIER "%%) [%d/" SIZE_T_SPECIFIER "]", percentage, fileindex, filecount);
 			}
 			else
 			{
-				++it;
+				statcount++;
 			}
-		}
-	}
 
-	// Give a list of missing textures
-	if (parseresource && !resourcePaths.empty() && verbal)
-	{
-		if (!texturelist.empty())
-		{
-			status = 2; // res file might not be complete
-			for(StringMap::const_iterator it = texturelist.begin(); it != texturelist.end(); ++it)
-			{
-				printf("Texture not found in wad files: %s\n", it->second.c_str());
-			}
+			kv = entDataTokenizer.NextPair();
 		}
 	}
-
-	if (resfile.empty() && rfastring.empty())
+	catch(ParseException &parseException)
 	{
-		// no resources!
-		if (verbal) { printf("No resources were found for \"%s.res\".", basefilename.c_str()); }
-
-		if (fileexists)
+		if(parseException.GetCharNum() >= 0)
 		{
-			// File exists, delete it.
-			// WHAT? No check for overwrite? No!
-			// Think of it, if the file exists we MUST be in overwrite mode to even get to this point!
-			remove(resName.c_str());
-			if (verbal)
-			{
-				printf(" Deleting existing res file.\n");
-			}
+			Print("Failed to parse '%s': %s (char: %d)\n", map.c_str(), parseException.what(), parseException.GetCharNum());
 		}
 		else
 		{
-			// File doesn't exist, so we don't have to delete it.
-			if (verbal)
-			{
-				printf(" Skipping file.\n");
-			}
+			Print("Failed to parse '%s': %s\n", map.c_str(), parseException.what());
 		}
-		return status;
-	}
-
-	// Collecting resfile entries is done, now write the res file.
-	if (!WriteRes(basefolder, basefilename))
-	{
-		return 1;
+		return false;
 	}
 
-	// File written successfully. We can safely erase the resfile and texture list
-	resfile.clear();
-	texturelist.clear();
-
-	return status;
+	return true;
 }
 
-bool RESGen::LoadBSPData(const std::string &file, std::string &entdata, StringMap & texlist)
+bool RESGen::LoadBSPData(const std::string &file, BspFile &bsp, const char *&entdata, size_t &entlength, NameList &texlist)
 {
-	// first open the file.
-	File bsp(file, "rb"); // read in binary mode.
-
-	if (bsp == NULL)
+	// first map the file.
+	if (!bsp.Open(file, !mapsMayChange))
 	{
-		printf("Error opening \"%s\"\n", file.c_str());
+		Print("Error opening \"%s\"\n", file.c_str());
 		return false;
 	}
 
 	// file open.. read header
 	bsp_header header;
 
-	if (fread(&header, sizeof(bsp_header), 1, bsp) != 1)
+	if (bsp.GetSize() < sizeof(bsp_header))
 	{
 		// header NOT read properly!
-		printf("Error opening \"%s\". Corrupt BSP file.\n", file.c_str());
+		Print("Error opening \"%s\". Corrupt BSP file.\n", file.c_str());
 		return false;
 	}
 
+	memcpy(&header, bsp.GetData(), sizeof(bsp_header));
+
 	if (header.version != BSPVERSION)
 	{
-		printf("Error opening \"%s\". Incorrect BSP version.\n", file.c_str());
+		Print("Error opening \"%s\". Incorrect BSP version.\n", file.c_str());
 		return false;
 	}
 
 	if (header.ent_header.fileofs <= 0)
 	{
 		// File corrupted
-		printf("Error opening \"%s\". Corrupt BSP header.\n", file.c_str());
+		Print("Error opening \"%s\". Corrupt BSP header.\n", file.c_str());
 		return false;
 	}
 
-	// read entity data
-	entdata.resize(header.ent_header.filelen);
-
-	fseek(bsp, header.ent_header.fileofs, SEEK_SET);
-	if (fread(&entdata[0], header.ent_header.filelen, 1, bsp) != 1)
+	// entity data, must lie within the file
+	if (!bsp.GetLump(header.ent_header, entdata, entlength) || entlength == 0)
 	{
 		// not the right ammount of data was read
-		printf("Error opening \"%s\". BSP file corrupt.\n", file.c_str());
+		Print("Error opening \"%s\". BSP file corrupt.\n", file.c_str());
 		return false;
 	}
 
-	if (parseresource && !resourcePaths.empty())
+	if (parseresource && resourceIndex->HasRoots())
 	{
-		// Load names of external textures
-		fseek(bsp, header.tex_header.fileofs, SEEK_SET); // go to start of texture data
-		size_t texcount;
+		// Load names of external textures. The whole texture lump is
+		// walked in the mapping, every offset checked against its length.
+		const char *texlump;
+		size_t texlength;
+		int32_t texcount;
 
-		if (fread(&texcount, sizeof(int), 1, bsp) != 1) // first we want to know the number of files.
+		if (!bsp.GetLump(header.tex_header, texlump, texlength) || texlength < sizeof(int32_t)) // first we want to know the number of files.
 		{
 			// header NOT read properly!
-			printf("Error opening \"%s\". Corrupt texture header.\n", file.c_str());
+			Print("Error opening \"%s\". Corrupt texture header.\n", file.c_str());
 			return false;
 		}
 
+		memcpy(&texcount, texlump, sizeof(int32_t));
+
 		if (texcount > 0)
 		{
-			// Textures available, read all offsets
-			std::vector<char> offsets(sizeof(int) * texcount);
-
-			size_t i = fread(offsets.data(), sizeof(int), texcount, bsp);
+			// Textures available, check all offsets fit
+			const size_t count = static_cast<size_t>(texcount);
+			const size_t available = (texlength - sizeof(int32_t)) / sizeof(int32_t);
 
-			if (i != texcount) // load texture offsets
+			if (count > available) // load texture offsets
 			{
 				// header NOT read properly!
-				printf("Error opening \"%s\". Corrupt texture data.\n  read: " SIZE_T_SPECIFIER ", expect: " SIZE_T_SPECIFIER "\n", file.c_str(), i, texcount);
+				Print("Error opening \"%s\". Corrupt texture data.\n  read: " SIZE_T_SPECIFIER ", expect: " SIZE_T_SPECIFIER "\n", file.c_str(), available, count);
 				return false;
 			}
 
-			for (i = 0; i < texcount; i++)
+			const char *offsets = texlump + sizeof(int32_t);
+
+			for (size_t i = 0; i < count; i++)
 			{
-				// go to texture location
-				fseek(bsp, header.tex_header.fileofs + offsets[i], SEEK_SET);
+				int32_t offset;
+				memcpy(&offset, offsets + i * sizeof(int32_t), sizeof(int32_t));
 
-				// read texture data
-				texdata_s texdata;
-				if (fread(&texdata, sizeof(texdata_s), 1, bsp) != 1)
+				if (offset < 0)
+				{
+					// Texture left out by the compiler
+					continue;
+				}
+
+				// texture location must lie within the lump
+				if (static_cast<size_t>(offset) > texlength || sizeof(texdata_s) > texlength - static_cast<size_t>(offset))
 				{
 					// header NOT read properly!
-					printf("Error opening \"%s\". Corrupt BSP file.\n", file.c_str());
+					Print("Error opening \"%s\". Corrupt BSP file.\n", file.c_str());
 					return false;
 				}
 
+				texdata_s texdata;
+				memcpy(&texdata, texlump + offset, sizeof(texdata_s));
+
 				// is this a wad based texture?
 				if (texdata.offsets[0] == 0 && texdata.offsets[1] == 0 && texdata.offsets[2] == 0 && texdata.offsets[3] == 0)
 				{
 					// No texture for any mip level, so must be in a wad
-					std::string texfileLower = strToLowerCopy(texdata.name);
-					texlist[texfileLower] = texdata.name;
+					// The name isn't always NUL terminated
+					texlist.Add(texdata.name, strnlen(texdata.name, sizeof(texdata.name)));
 				}
 			}
 		}
@@ -623,7 +788,7 @@ bool RESGen::LoadBSPData(const std::string &file, std::string &entdata, StringMa
 	#ifdef _DEBUG
 	// Debug write entity data to file
 	File tmp(file + "_ent.txt", "w");
-	fprintf(tmp, "%s", entdata.c_str());
+	fwrite(entdata, 1, entlength, tmp);
 	#endif
 
 	return true;
@@ -669,12 +834,12 @@ void RESGen::AddRes(std::string res, const char * const prefix, const char * con
 	// Add file to list if it isn't in it yet.
 	// We shouldn't care if this overwrites a previous entry (it shouldn't) -
 	// it'll only differ by case
-	resfile[strToLowerCopy(res)] = res;
+	resfile.Add(res);
 
 	// Report file found
 	if (contentdisp)
 	{
-		printf("\r%-21s\n", res.c_str()); // With 21 chars, there is support for up to 999999 bsp's to parse untill the statbar might remain in screen
+		Print("\r%-21s\n", res.c_str()); // With 21 chars, there is support for up to 999999 bsp's to parse untill the statbar might remain in screen
 	}
 
 	statcount = STAT_MAX; // Make statbar print on next update
@@ -695,40 +860,58 @@ void RESGen::AddWad(const std::string &wadlist, size_t start, size_t len)
 	AddRes(wadfile);
 }
 
-bool RESGen::WriteRes(const std::string &folder, const std::string &mapname)
+bool RESGen::WriteRes(const std::string &folder, const std::string &mapname, int fileindex)
 {
 	// This function writes a standard res file.
+	const std::string fileName = folder + mapname + ".res";
 
-	// Open the file
-	File f(folder + mapname + ".res", "w");
+	std::string contents;
+	FormatRes(mapname, contents);
 
-	if (f == NULL)
+	if (reswriter)
+	{
+		// Written in the background, failures are reported by the writer
+		reswriter->Write(fileindex, fileName, contents);
+		return true;
+	}
+
+	std::string error;
+	if (!ResWriter::WriteResFile(fileName, contents, error))
 	{
-		printf("Failed to open %s for writing.\n", (folder + mapname + ".res").c_str());
+		Print("%s", error.c_str());
 		return false;
 	}
 
+	return true;
+}
+
+void RESGen::FormatRes(const std::string &mapname, std::string &contents) const
+{
 	// Header
-	fprintf(f, "// %s - created with RESGen v%s.\n", (mapname + ".res").c_str(), VERSION);
-	fprintf(f, "// RESGen is made by Jeroen \"ShadowLord\" Bogers,\n");
-	fprintf(f, "// with serveral improvements and additions by Zero3Cool.\n");
-	fprintf(f, "// For more info go to http://resgen.hltools.com\n");
+	appendFormat(contents, "// %s - created with RESGen v%s.\n", (mapname + ".res").c_str(), VERSION);
+	contents += "// RESGen is made by Jeroen \"ShadowLord\" Bogers,\n";
+	contents += "// with serveral improvements and additions by Zero3Cool.\n";
+	contents += "// For more info go to http://resgen.hltools.com\n";
 
-	fprintf(f, "\n// .res entries (" SIZE_T_SPECIFIER "):\n", resfile.size());
+	appendFormat(contents, "\n// .res entries (" SIZE_T_SPECIFIER "):\n", resfile.Size());
 
 	// Resources
-	for (StringMap::const_iterator it = resfile.begin(); it != resfile.end(); ++it)
+	for (size_t i = 0; i < resfile.Count(); i++)
 	{
-		fprintf(f, "%s\n", it->second.c_str());
+		if (!resfile[i].erased)
+		{
+			contents += resfile[i].name;
+			contents += '\n';
+		}
 	}
 
 	// RFA file, if needed
 	if (!rfastring.empty())
 	{
-		fprintf(f, "\n// Added .res content:\n%s\n", rfastring.c_str());
+		contents += "\n// Added .res content:\n";
+		contents += rfastring;
+		contents += '\n';
 	}
-
-	return true;
 }
 
 bool RESGen::LoadRfaFile(std::string &filename)
@@ -755,7 +938,7 @@ bool RESGen::LoadRfaFile(std::string &filename)
 	}
 	else
 	{
-		printf("Error reading rfa file: \"%s\"\n", filename.c_str());
+		Print("Error reading rfa file: \"%s\"\n", filename.c_str());
 	}
 
 	return bSuccess;
@@ -780,7 +963,7 @@ bool RESGen::LoadExludeFile(std::string &listfile)
 	if (f == NULL)
 	{
 		// Error opening file, abort
-		printf("Error: Could not open the specified exclude list %s!\n", listfile.c_str());
+		Print("Error: Could not open the specified exclude list %s!\n", listfile.c_str());
 		return false;
 	}
 
@@ -826,148 +1009,295 @@ bool RESGen::LoadExludeFile(std::string &listfile)
 	return true;
 }
 
-bool RESGen::CacheWad(const std::string &wadfile)
+bool RESGen::CacheWad(const resource_s &resource, TextureSet &textures)
 {
+	const std::string wadfile = resource.name;
+	const std::string path = resourceIndex->GetPath(resource);
+
+	if (assets && assets->FindWad(path, AssetOffset(resource), textures))
+	{
+		// Parsed by an earlier run, and the file didn't change since
+		return true;
+	}
+
+	const PrefetchedFile *prefetch = FindPrefetched(wadfile);
+
 	File wad;
-	if(!OpenFirstValidPath(wad, wadfile, "rb"))
+	long base = 0;
+	long size = 0;
+	if(prefetch ? !prefetch->opened : !OpenResource(wad, resource, base, size))
 	{
-		printf("Failed to open WAD file \"%s\".\n", wadfile.c_str());
+		Print("Failed to open WAD file \"%s\".\n", wadfile.c_str());
 		return false;
 	}
 
 	wadheader_s header;
-	if (fread(&header, sizeof(wadheader_s), 1, wad) != 1)
+	if (prefetch ? (prefetch->header.size() != sizeof(wadheader_s)) : (fread(&header, sizeof(wadheader_s), 1, wad) != 1))
 	{
-		printf("WAD file \"%s\" is corrupt.\n", wadfile.c_str());
+		Print("WAD file \"%s\" is corrupt.\n", wadfile.c_str());
 		return false;
 	}
 
-	if (strncmp(header.identification, "WAD", 3))
+	if (prefetch)
 	{
-		printf("\"%s\" is not a WAD file.\n", wadfile.c_str());
-		return false;
+		memcpy(&header, prefetch->header.data(), sizeof(wadheader_s));
 	}
 
-	if (header.identification[3] != '2' && header.identification[3] != '3')
+	if (strncmp(header.identification, "WAD", 3))
 	{
-		printf("Incorrect WAD file version for \"%s\"\n", wadfile.c_str());
+		Print("\"%s\" is not a WAD file.\n", wadfile.c_str());
 		return false;
 	}
 
-	if (fseek(wad, header.infotableofs, SEEK_SET))
+	if (header.identification[3] != '2' && header.identification[3] != '3')
 	{
-		printf("Cannot find WAD info table in \"%s\"\n", wadfile.c_str());
+		Print("Incorrect WAD file version for \"%s\"\n", wadfile.c_str());
 		return false;
 	}
 
-	const std::string wadFileLower(strToLowerCopy(wadfile));
+	const size_t lumpcount = (header.numlumps > 0) ? static_cast<size_t>(header.numlumps) : 0;
+	std::string table;
+	const std::string *tabledata = &table;
 
-	for (int i = 0; i < header.numlumps; i++)
+	if (prefetch && prefetch->hastable)
+	{
+		tabledata = &prefetch->table;
+	}
+	else
 	{
-		wadlumpinfo_s lumpinfo;
-		if (fread(&lumpinfo, sizeof(wadlumpinfo_s), 1, wad) != 1)
+		if (prefetch && !OpenResource(wad, resource, base, size))
+		{
+			// Lump table wasn't prefetched, read it from the file
+			Print("Failed to open WAD file \"%s\".\n", wadfile.c_str());
+			return false;
+		}
+
+		if (header.infotableofs < 0 || fseek(wad, base + header.infotableofs, SEEK_SET))
 		{
-			printf("WAD file info table \"%s\" is corrupt.\n", wadfile.c_str());
+			Print("Cannot find WAD info table in \"%s\"\n", wadfile.c_str());
 			return false;
 		}
 
-		std::string lumpNameLower(lumpinfo.name);
-		strToLower(lumpNameLower);
-		wadcache[wadFileLower].insert(lumpNameLower);
+		if (lumpcount > 0)
+		{
+			// Read the whole table at once, but no more than the file holds
+			const size_t available = (size > header.infotableofs) ? static_cast<size_t>(size - header.infotableofs) : 0;
+			table.resize(std::min(lumpcount * sizeof(wadlumpinfo_s), available));
+
+			if (!table.empty() && !fseek(wad, base + header.infotableofs, SEEK_SET))
+			{
+				table.resize(fread(&table[0], 1, table.size(), wad));
+			}
+			else
+			{
+				table.clear();
+			}
+		}
+	}
+
+	if (tabledata->size() / sizeof(wadlumpinfo_s) < lumpcount)
+	{
+		Print("WAD file info table \"%s\" is corrupt.\n", wadfile.c_str());
+		return false;
+	}
+
+	textures.Assign(tabledata->data(), lumpcount);
+
+	if (assets)
+	{
+		assets->StoreWad(path, AssetOffset(resource), textures);
 	}
 
 	return true;
 }
 
-bool RESGen::CheckWadUse(const StringMap::const_iterator &wadfileIt)
+bool RESGen::CheckWadUse(const std::string &wadfileLower, const resource_s &wadfile)
 {
-	WadCache::const_iterator wadIt = wadcache.find(wadfileIt->first);
+	AddFileDependency(resourceIndex->GetPath(wadfile));
 
-	if(wadIt == wadcache.end())
+	WadTextureMap::const_iterator wadIt = wadtextures.find(wadfileLower);
+
+	if(wadIt == wadtextures.end())
 	{
-		// Haven't read this wad yet
-		if(!CacheWad(wadfileIt->second))
-		{
-			// Failed to read wad
-			// Cache this failure with an empty set to prevent wad being marked
-			// as used
-			wadcache[wadfileIt->first] = TextureSet();
-			return false;
-		}
+		// Haven't used this wad yet, get it from the shared cache. It is only
+		// read from disk if no other RESGen has done so already.
+		const TextureSet &textures = wadcache->GetTextures(
+			wadfileLower,
+			std::bind(&RESGen::CacheWad, this, std::cref(wadfile), std::placeholders::_1));
 
-		wadIt = wadcache.find(wadfileIt->first);
+		wadIt = wadtextures.insert(std::make_pair(wadfileLower, &textures)).first;
 	}
 
-	assert(wadIt != wadcache.end());
+	assert(wadIt != wadtextures.end());
 
 	bool bWadUsed = false;
 
-	const TextureSet& textureSet = wadIt->second;
-
-	StringMap::iterator it = texturelist.begin();
+	const TextureSet& textureSet = *wadIt->second;
 
 	// Look through all unfound textures and remove any that appear in this wad
-	while(it != texturelist.end())
+	for (size_t i = 0; i < texturelist.Count(); i++)
 	{
-		TextureSet::const_iterator textureIt = textureSet.find(it->first);
-
-		if(textureIt != textureSet.end())
+		if(!texturelist[i].erased && textureSet.Contains(texturelist[i].nameLower))
 		{
 			// found a texture, so wad is used
 			bWadUsed = true;
 
 			// update texture list
-			it = texturelist.erase(it);
-		}
-		else
-		{
-			++it;
+			texturelist.Erase(i);
 		}
 	}
 
 	return bWadUsed;
 }
 
-bool RESGen::CheckModelExtTexture(const std::string &model)
+bool RESGen::CheckModelExtTexture(const resource_s &resource)
 {
+	const std::string model = resource.name;
+	const std::string path = resourceIndex->GetPath(resource);
+
+	AddFileDependency(path);
+
+	bool exttexture;
+	if (assets && assets->FindModel(path, AssetOffset(resource), exttexture))
+	{
+		// Parsed by an earlier run, and the file didn't change since
+		return exttexture;
+	}
+
+	const PrefetchedFile *prefetch = FindPrefetched(model);
+
 	File mdl;
-	if(!OpenFirstValidPath(mdl, model, "rb"))
+	long base = 0;
+	long size = 0;
+	if(prefetch ? !prefetch->opened : !OpenResource(mdl, resource, base, size))
 	{
-		printf("Failed to open MDL file \"%s\".\n", model.c_str());
+		Print("Failed to open MDL file \"%s\".\n", model.c_str());
 		return false;
 	}
 
 	modelheader_s header;
-	if (fread(&header, sizeof(modelheader_s), 1, mdl) != 1)
+	if (prefetch ? (prefetch->header.size() != sizeof(modelheader_s)) : (fread(&header, sizeof(modelheader_s), 1, mdl) != 1))
 	{
-		printf("MDL file \"%s\" is corrupt.\n", model.c_str());
+		Print("MDL file \"%s\" is corrupt.\n", model.c_str());
 		return false;
 	}
 
+	if (prefetch)
+	{
+		memcpy(&header, prefetch->header.data(), sizeof(modelheader_s));
+	}
+
 	if (strncmp(header.id, "IDST", 4))
 	{
-		printf("\"%s\" is not a MDL file.\n", model.c_str());
+		Print("\"%s\" is not a MDL file.\n", model.c_str());
 		return false;
 	}
 
 	if (header.version != 10)
 	{
-		printf("Incorrect MDL file version for \"%s\"\n", model.c_str());
+		Print("Incorrect MDL file version for \"%s\"\n", model.c_str());
 		return false;
 	}
 
-	if (header.textureindex == 0)
+	exttexture = (header.textureindex == 0); // Uses seperate texture
+
+	if (assets)
+	{
+		assets->StoreModel(path, AssetOffset(resource), exttexture);
+	}
+
+	return exttexture;
+}
+
+void RESGen::AddCompanionFiles(const std::string &basefolder, const std::string &basefilename)
+{
+	bool applied = false;
+
+	for (size_t i = 0; i < sizeof(companions) / sizeof(companions[0]); i++)
+	{
+		const companion_s &rule = companions[i];
+
+		if (rule.alternative && applied)
+		{
+			continue;
+		}
+
+		applied = true;
+		for (size_t j = 0; j < 3 && rule.suffixes[j] && applied; j++)
+		{
+			applied = CompanionExists(basefolder, rule.folder + basefilename + rule.suffixes[j]);
+		}
+
+		if (applied)
+		{
+			for (size_t j = 0; j < 3 && rule.suffixes[j]; j++)
+			{
+				AddRes(basefilename, rule.folder, rule.suffixes[j]);
+			}
+		}
+	}
+}
+
+bool RESGen::CompanionExists(const std::string &basefolder, const std::string &file)
+{
+	if (resourceIndex->HasRoots())
+	{
+		// The resource list has every file already
+		return FindResource(strToLowerCopy(file)) != NULL;
+	}
+
+	// Without resource paths the mod folder is the one above the map
+	const std::string path = basefolder + ".." + PATH_SEPARATOR + replaceCharAllCopy(file, '/', PATH_SEPARATOR);
+	AddFileDependency(path);
+	return fileExists(path);
+}
+
+const resource_s *RESGen::FindResource(const std::string &nameLower)
+{
+	const resource_s *resource = resourceIndex->Find(nameLower);
+
+	if (manifest)
+	{
+		// The map is processed again if the answer changes
+		dependency_s dependency;
+		dependency.type = 'r';
+		dependency.name = nameLower;
+		if (resource)
+		{
+			dependency.found = resource->name;
+		}
+		dependencies.push_back(dependency);
+	}
+
+	return resource;
+}
+
+void RESGen::AddFileDependency(const std::string &path)
+{
+	if (!manifest)
+	{
+		return;
+	}
+
+	// WADs and MDLs in the same pak file give the same path
+	for (std::vector<dependency_s>::const_iterator it = dependencies.begin(); it != dependencies.end(); ++it)
 	{
-		return true; // Uses seperate texture
+		if (it->type == 'f' && it->name == path)
+		{
+			return;
+		}
 	}
 
-	return false;
+	dependency_s dependency;
+	dependency.type = 'f';
+	dependency.name = path;
+	dependencies.push_back(dependency);
 }
 
-void RESGen::ParseSentence(const char* const sentence)
+void RESGen::ParseSentence(const char* const sentence, size_t length)
 {
 	// Not so performance critical here
-	std::string sentenceLower(sentence);
+	std::string sentenceLower(sentence, length);
 	strToLower(sentenceLower);
 
 	if(
@@ -1051,18 +1381,144 @@ void RESGen::ParseSentence(const char* const sentence)
 	}
 }
 
-bool RESGen::OpenFirstValidPath(File &outFile, std::string fileName, const char* const mode)
+void RESGen::PrefetchHeaders()
 {
-	for(std::vector<std::string>::const_iterator it = resourcePaths.begin(); it != resourcePaths.end(); ++it)
+	prefetched.clear();
+	headerreader.Begin();
+
+	for (size_t i = 0; i < resfile.Count(); i++)
 	{
-		outFile.open(*it + fileName, mode);
+		const std::string &nameLower = resfile[i].nameLower;
 
-		if(outFile)
+		const resource_s *resource = resourceIndex->Find(nameLower);
+		if (resource == NULL)
 		{
-			return true;
+			continue;
 		}
+
+		if (!CompareStrEnd(nameLower, ".wad"))
+		{
+			// Skip WADs some RESGen has read already
+			if (wadtextures.find(nameLower) != wadtextures.end() || wadcache->Contains(nameLower))
+			{
+				continue;
+			}
+		}
+		else if (CompareStrEnd(nameLower, ".mdl"))
+		{
+			continue;
+		}
+
+		// Nor files an earlier run parsed already
+		if (assets && assets->Contains(CompareStrEnd(nameLower, ".wad") ? 'm' : 'w', resourceIndex->GetPath(*resource), AssetOffset(*resource)))
+		{
+			continue;
+		}
+
+		PrefetchedFile &file = prefetched[resource->name];
+		file.hastable = false;
+
+		if (resource->pak < 0)
+		{
+			file.reader = headerreader.Add(resourceIndex->GetPath(*resource));
+		}
+		else
+		{
+			// Pak entries are read from the pak file
+			file.reader = headerreader.AddRange(resourceIndex->GetPath(*resource), static_cast<long>(resource->offset), resource->length);
+		}
+	}
+
+	if (prefetched.empty())
+	{
+		return;
+	}
+
+	headerreader.Open();
+
+	for (PrefetchMap::iterator it = prefetched.begin(); it != prefetched.end(); ++it)
+	{
+		PrefetchedFile &file = it->second;
+		file.opened = headerreader.IsOpen(file.reader);
+
+		if (file.opened)
+		{
+			const bool wad = !CompareStrEndNoCase(it->first, ".wad");
+			headerreader.Queue(file.reader, 0, wad ? sizeof(wadheader_s) : sizeof(modelheader_s), file.header);
+		}
+	}
+
+	headerreader.Read();
+
+	// WAD lump tables are found through the header, so they are a second batch
+	for (PrefetchMap::iterator it = prefetched.begin(); it != prefetched.end(); ++it)
+	{
+		PrefetchedFile &file = it->second;
+		if (CompareStrEndNoCase(it->first, ".wad") || file.header.size() != sizeof(wadheader_s))
+		{
+			continue;
+		}
+
+		wadheader_s header;
+		memcpy(&header, file.header.data(), sizeof(wadheader_s));
+
+		// Leave odd tables to CacheWad, which reads them lump by lump
+		if (header.infotableofs >= 0 && header.numlumps <= MAX_PREFETCH_LUMPS)
+		{
+			const size_t lumpcount = (header.numlumps > 0) ? static_cast<size_t>(header.numlumps) : 0;
+			headerreader.Queue(file.reader, header.infotableofs, lumpcount * sizeof(wadlumpinfo_s), file.table);
+			file.hastable = true;
+		}
+	}
+
+	headerreader.Read();
+	headerreader.Close();
+}
+
+const RESGen::PrefetchedFile *RESGen::FindPrefetched(const std::string &fileName) const
+{
+	PrefetchMap::const_iterator it = prefetched.find(fileName);
+	return (it != prefetched.end()) ? &it->second : NULL;
+}
+
+bool RESGen::OpenResource(File &outFile, const resource_s &resource, long &base, long &size)
+{
+	outFile.open(resourceIndex->GetPath(resource), "rb");
+
+	if (!outFile)
+	{
+		return false;
+	}
+
+	if (resource.pak >= 0)
+	{
+		// A range of the pak file
+		base = static_cast<long>(resource.offset);
+		size = static_cast<long>(resource.length);
+	}
+	else
+	{
+		base = 0;
+		size = fseek(outFile, 0, SEEK_END) ? -1 : ftell(outFile);
 	}
 
-	return false;
+	return !fseek(outFile, base, SEEK_SET);
 }
 
+void RESGen::Print(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+
+	if (output == NULL)
+	{
+		vprintf(format, args);
+	}
+	else
+	{
+		// Buffered output, used when running on a worker thread
+		appendFormatV(*output, format, args);
+	}
+
+	va_end(args);
+}
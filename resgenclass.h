@@ -35,7 +35,17 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <string>
 #include <vector>
 
+#include "bspfile.h"
+#include "assetstore.h"
+#include "headerreader.h"
+#include "manifest.h"
+#include "namelist.h"
+#include "resultcache.h"
+#include "resourceindex.h"
 #include "util.h"
+#include "wadcache.h"
+
+class ResWriter;
 
 std::vector<std::string>::iterator findStringNoCase(std::vector<std::string> &vec, const std::string &element);
 
@@ -46,34 +56,72 @@ public:
 
 	bool LoadExludeFile(std::string &listfile);
 	bool LoadRfaFile(std::string &pakfilename);
-	int MakeRES(std::string &map, int fileindex, size_t filecount, const StringMap &resources, std::vector<std::string> &resourcePaths_);
+	int MakeRES(std::string &map, int fileindex, size_t filecount, const ResourceIndex &resources);
 	void SetParams(bool beverbal, bool statline, bool overwrt, bool lcase, bool mcase, bool prsresource, bool preservewads, bool cdisp);
+	void SetOutputBuffer(std::string *buffer);
+	void SetResWriter(ResWriter *writer);
+	void SetManifest(Manifest *incremental);
+	void SetAssetStore(AssetStore *store);
+	void SetResultCache(const ResultCache *cache);
+
+	// BSP files are read instead of memory mapped if set, for maps that may
+	// be replaced while they are parsed
+	void SetMapsMayChange(bool mayChange);
+
+	// For runs that keep going, files read before now may have changed since.
+	// WADs are only read again if resourcesChanged is set, copies made
+	// before keep the ones they read.
+	void BeginRun(bool resourcesChanged);
 	RESGen();
 	virtual ~RESGen();
 
 private:
-	typedef std::set<std::string> TextureSet;
-	typedef std::map<std::string, TextureSet> WadCache;
-
-	bool CheckModelExtTexture(const std::string &model);
-	bool CacheWad(const std::string &wadfile);
-	bool CheckWadUse(const StringMap::const_iterator &wadfileIt);
-	bool WriteRes(const std::string &folder, const std::string &mapname);
+	typedef WadCache::TextureSet TextureSet;
+	typedef std::map<std::string, const TextureSet*> WadTextureMap;
+
+	// Start of a WAD or MDL file, read before the resource check needs it
+	struct PrefetchedFile
+	{
+		size_t reader; // Index in headerreader
+		bool opened;
+		std::string header;
+		bool hastable; // WADs only, false if table must be read from the file
+		std::string table; // WAD lump table
+	};
+	typedef std::map<std::string, PrefetchedFile> PrefetchMap;
+
+	void PrefetchHeaders();
+	const PrefetchedFile *FindPrefetched(const std::string &fileName) const;
+
+	bool CheckModelExtTexture(const resource_s &model);
+	bool CacheWad(const resource_s &wadfile, TextureSet &textures);
+	bool CheckWadUse(const std::string &wadfileLower, const resource_s &wadfile);
+	bool WriteRes(const std::string &folder, const std::string &mapname, int fileindex);
+	void FormatRes(const std::string &mapname, std::string &contents) const;
 	void AddWad(const std::string &wadlist, size_t start, size_t len);
 	void AddRes(std::string res, const char * const prefix = NULL, const char * const suffix = NULL);
-	bool LoadBSPData(const std::string &file, std::string &entdata, StringMap & texlist);
-	void ParseSentence(const char* const sentence);
-	bool OpenFirstValidPath(File &outFile, std::string fileName, const char* const mode);
+	void AddCompanionFiles(const std::string &basefolder, const std::string &basefilename);
+	bool CompanionExists(const std::string &basefolder, const std::string &file);
+	const resource_s *FindResource(const std::string &nameLower);
+	void AddFileDependency(const std::string &path);
+	bool ParseEntities(const std::string &map, const char *entdata, size_t entlength, int fileindex, size_t filecount);
+	bool LoadBSPData(const std::string &file, BspFile &bsp, const char *&entdata, size_t &entlength, NameList &texlist);
+	void ParseSentence(const char* const sentence, size_t length);
+	bool OpenResource(File &outFile, const resource_s &resource, long &base, long &size);
+	void Print(const char *format, ...) PRINTF_FORMAT(2, 3);
 
 private:
 	bool checkforexcludes;
 	bool resourcedisp;
 	bool contentdisp;
 	int statcount; // statusbar counter
-	StringMap resfile;
-	StringMap texturelist;
+	NameList resfile; // Resources of the current map
+	NameList texturelist; // Textures of the current map not found in a WAD yet
 	StringMap excludelist;
-	WadCache wadcache;
+	std::shared_ptr<WadCache> wadcache; // Shared by all copies of this RESGen
+	WadTextureMap wadtextures; // WADs this instance got from wadcache already
+	HeaderReader headerreader;
+	PrefetchMap prefetched; // WAD and MDL headers of the current map, by file name
 	bool verbal;
 	bool statusline;
 	bool overwrite;
@@ -81,8 +129,15 @@ private:
 	bool matchcase;
 	bool parseresource;
 	bool preservewads;
+	bool mapsMayChange;
 	std::string rfastring;
-	std::vector<std::string> resourcePaths;
+	const ResourceIndex *resourceIndex; // Resources of the current map
+	std::string *output; // Console output goes here instead of stdout if set
+	ResWriter *reswriter; // Writes res files in the background if set
+	Manifest *manifest; // Maps that didn't change since the last run are skipped if set
+	AssetStore *assets; // WAD and MDL files parsed by earlier runs if set
+	const ResultCache *resultcache; // Resource lists of entity lumps parsed before if set
+	std::vector<dependency_s> dependencies; // Of the current map, kept for manifest
 };
 
 #endif // !defined(AFX_RESGENCLASS_H__5EDE8CED_D2D4_4D20_846F_5A1034433CDD__INCLUDED_)
@@ -0,0 +1,227 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <algorithm>
+#include <ctype.h>
+#include <string.h>
+
+#include "resourceindex.h"
+#include "util.h"
+
+// Names are stored in blocks of this size, longer names get their own
+#define RESOURCEINDEX_BLOCK 65536
+
+// Smallest table, always a power of two
+#define RESOURCEINDEX_SLOTS 1024
+
+ResourceIndex::ResourceIndex()
+	: blockUsed(0), blockSize(0)
+{
+}
+
+ResourceIndex::ResourceIndex(const ResourceIndex &other)
+	: blockUsed(0), blockSize(0)
+{
+	*this = other;
+}
+
+ResourceIndex& ResourceIndex::operator=(const ResourceIndex &other)
+{
+	if (this == &other)
+	{
+		return *this;
+	}
+
+	resources = other.resources;
+	hashes = other.hashes;
+	slots = other.slots;
+	roots = other.roots;
+	paks = other.paks;
+
+	blocks.clear();
+	blockUsed = 0;
+	blockSize = 0;
+
+	// The names still point into the blocks of the other index
+	for (std::vector<resource_s>::iterator it = resources.begin(); it != resources.end(); ++it)
+	{
+		const bool sameFile = (it->file == it->name);
+		it->name = StoreName(it->name, strlen(it->name));
+		it->file = sameFile ? it->name : StoreName(it->file, strlen(it->file));
+	}
+
+	return *this;
+}
+
+void ResourceIndex::Add(const resource_s &resource)
+{
+	if (slots.empty() || (resources.size() + 1) * 2 > slots.size())
+	{
+		// Kept at most half full, so probes stay short
+		Grow();
+	}
+
+	const size_t length = strlen(resource.name);
+	const uint32_t hash = hashStringNoCase(resource.name, length);
+	const size_t mask = slots.size() - 1;
+
+	size_t slot = hash & mask;
+	for (; slots[slot] != 0; slot = (slot + 1) & mask)
+	{
+		resource_s &entry = resources[slots[slot] - 1];
+		if (hashes[slots[slot] - 1] != hash || !SameName(entry.name, resource.name, length))
+		{
+			continue;
+		}
+
+		const char *name = strcmp(entry.name, resource.name) ? StoreName(resource.name, length) : entry.name;
+
+		if (resource.root > entry.root || (resource.root == entry.root && resource.pak >= 0 && entry.pak < 0))
+		{
+			// Comes first in the search order, so it is the one the game
+			// loads. Only the name is taken.
+			entry.name = name;
+			return;
+		}
+
+		entry = resource;
+		entry.name = name;
+		entry.file = name;
+
+		return;
+	}
+
+	resources.push_back(resource);
+	resources.back().name = StoreName(resource.name, length);
+	resources.back().file = resources.back().name;
+	hashes.push_back(hash);
+	slots[slot] = static_cast<uint32_t>(resources.size());
+}
+
+int ResourceIndex::AddRoot(const std::string &path)
+{
+	roots.push_back(path);
+	return static_cast<int>(roots.size() - 1);
+}
+
+int ResourceIndex::AddPak(const std::string &pakfile)
+{
+	paks.push_back(pakfile);
+	return static_cast<int>(paks.size() - 1);
+}
+
+bool ResourceIndex::HasRoots() const
+{
+	return !roots.empty();
+}
+
+const resource_s *ResourceIndex::Find(const std::string &nameLower) const
+{
+	if (slots.empty())
+	{
+		return NULL;
+	}
+
+	const size_t length = nameLower.length();
+	const uint32_t hash = hashStringNoCase(nameLower.c_str(), length);
+	const size_t mask = slots.size() - 1;
+
+	for (size_t slot = hash & mask; slots[slot] != 0; slot = (slot + 1) & mask)
+	{
+		const size_t index = slots[slot] - 1;
+		if (hashes[index] == hash && SameName(resources[index].name, nameLower.c_str(), length))
+		{
+			return &resources[index];
+		}
+	}
+
+	return NULL;
+}
+
+std::string ResourceIndex::GetPath(const resource_s &resource) const
+{
+	if (resource.pak >= 0)
+	{
+		return paks[static_cast<size_t>(resource.pak)];
+	}
+
+	return roots[static_cast<size_t>(resource.root)] + resource.file;
+}
+
+void ResourceIndex::Swap(ResourceIndex &other)
+{
+	resources.swap(other.resources);
+	hashes.swap(other.hashes);
+	slots.swap(other.slots);
+	blocks.swap(other.blocks);
+	std::swap(blockUsed, other.blockUsed);
+	std::swap(blockSize, other.blockSize);
+	roots.swap(other.roots);
+	paks.swap(other.paks);
+}
+
+bool ResourceIndex::SameName(const char *name, const char *other, size_t length)
+{
+	for (size_t i = 0; i < length; i++)
+	{
+		if (tolower(static_cast<unsigned char>(name[i])) != tolower(static_cast<unsigned char>(other[i])))
+		{
+			return false;
+		}
+	}
+
+	return name[length] == '\0';
+}
+
+const char *ResourceIndex::StoreName(const char *name, size_t length)
+{
+	if (blockUsed + length + 1 > blockSize)
+	{
+		blockSize = std::max(static_cast<size_t>(RESOURCEINDEX_BLOCK), length + 1);
+		blockUsed = 0;
+		blocks.push_back(std::unique_ptr<char[]>(new char[blockSize]));
+	}
+
+	char *stored = blocks.back().get() + blockUsed;
+	memcpy(stored, name, length + 1);
+	blockUsed += length + 1;
+
+	return stored;
+}
+
+void ResourceIndex::Grow()
+{
+	std::vector<uint32_t> grown(slots.empty() ? RESOURCEINDEX_SLOTS : slots.size() * 2, 0);
+	const size_t mask = grown.size() - 1;
+
+	for (size_t index = 0; index < resources.size(); index++)
+	{
+		size_t slot = hashes[index] & mask;
+		while (grown[slot] != 0)
+		{
+			slot = (slot + 1) & mask;
+		}
+
+		grown[slot] = static_cast<uint32_t>(index + 1);
+	}
+
+	slots.swap(grown);
+}
@@ -0,0 +1,99 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef RESOURCEINDEX_H
+#define RESOURCEINDEX_H
+
+#include <cstddef>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Where a resource lives. Loose files are the name under their search
+// path, pak entries are a range of their pak file.
+struct resource_s
+{
+	const char *name; // Case as found on disk last, with / separators
+	const char *file; // Set by Add. Loose files: name on disk under root
+	int root; // Index of the search path it was found under
+	int pak; // Index of the pak file, -1 for loose files
+	uint32_t offset; // Pak entries only
+	uint32_t length; // Pak entries only
+};
+
+// Every resource found in the search paths, by lowercase name. Together
+// with the pak files it refers to this is a small virtual file system over
+// the loose files and pak contents of a mod.
+//
+// Large mods have tens of thousands of resources that are looked up for
+// every map, so names are only stored once, in their original case, in
+// blocks that never move. A flat open addressing table with a case
+// insensitive hash finds them without a lowercase copy of every name.
+class ResourceIndex
+{
+public:
+	ResourceIndex();
+	ResourceIndex(const ResourceIndex &other);
+	ResourceIndex& operator=(const ResourceIndex &other);
+
+	// Keeps the location of the resource with the same name that the game
+	// loads instead: one from an earlier search path, or a loose file of the
+	// same search path for pak entries. Replaces it otherwise. The name is
+	// always taken from the resource added last, like -m always did.
+	// Names are copied.
+	void Add(const resource_s &resource);
+	int AddRoot(const std::string &path);
+	int AddPak(const std::string &pakfile);
+
+	// False if no search paths were given, resources aren't checked then
+	bool HasRoots() const;
+
+	// NULL if there is no such resource. Names stay valid until the index
+	// is changed or destroyed.
+	const resource_s *Find(const std::string &nameLower) const;
+
+	// File holding the resource, the pak file for pak entries
+	std::string GetPath(const resource_s &resource) const;
+
+	// Exchanges the contents without copying any names
+	void Swap(ResourceIndex &other);
+
+private:
+	// Case insensitive, other is length characters long
+	static bool SameName(const char *name, const char *other, size_t length);
+
+	const char *StoreName(const char *name, size_t length);
+	void Grow();
+
+	std::vector<resource_s> resources;
+	std::vector<uint32_t> hashes; // Of each resource
+	std::vector<uint32_t> slots; // Index of a resource + 1, 0 if empty
+
+	std::vector<std::unique_ptr<char[]> > blocks; // Names, NUL terminated
+	size_t blockUsed;
+	size_t blockSize;
+
+	std::vector<std::string> roots;
+	std::vector<std::string> paks;
+};
+
+#endif // RESOURCEINDEX_H
@@ -20,27 +20,30 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
 #include <cstring>
+#include <functional>
 #include <vector>
 
 #ifdef _WIN32
 #include <windows.h>
-#else
-#include <glob.h>
-#include <sys/types.h>
-#include <dirent.h>
-#include <sys/stat.h>
-#include <unistd.h>
 #endif
 
+#include "dirreader.h"
 #include "hltypes.h"
 #include "resourcelistbuilder.h"
+#include "workqueue.h"
 
 ResourceListBuilder::ResourceListBuilder(const config_s &config)
 	: resourcedisp(false)
 	, pakparse(false)
-	, firstdir(false)
 	, verbal(config.verbal)
+	, jobs(config.jobs)
+	, cache(NULL)
+{
+}
+
+void ResourceListBuilder::SetCache(DirCache *dircache)
 {
+	cache = dircache;
 }
 
 void ResourceListBuilder::BuildResourceList(const std::vector<std::string> &paths, bool checkpak, bool rdisp)
@@ -54,27 +57,104 @@ void ResourceListBuilder::BuildResourceList(const std::vector<std::string> &path
 		return;
 	}
 
-	for(std::vector<std::string>::const_iterator it = paths.begin(); it != paths.end(); ++it)
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		resources.AddRoot(paths[i]);
+	}
+
+	// Walk all paths at once
+	std::vector<Listing> roots(paths.size());
+
+	{
+		WorkQueue queue(jobs);
+
+		for (size_t i = 0; i < paths.size(); i++)
+		{
+			queue.Add(std::bind(&ResourceListBuilder::ListDir, this, std::ref(queue), paths[i], std::string(), std::ref(roots[i]), true));
+		}
+
+		queue.Wait();
+	}
+
+	// Build the resource list in search path order. The index keeps the
+	// file of the earliest search path, and the case of the name found last,
+	// just like -m got when walking serially.
+	for (size_t i = 0; i < paths.size(); i++)
 	{
 		if (rdisp)
 		{
-			printf("Searching %s for resources:\n", it->c_str());
+			printf("Searching %s for resources:\n", paths[i].c_str());
 		}
 		else if (verbal)
 		{
-			printf("Searching %s for resources...\n", it->c_str());
+			printf("Searching %s for resources...\n", paths[i].c_str());
 		}
 
-		firstdir = true;
-		ListDir(*it, "", true);
+		MergeListing(roots[i], static_cast<int>(i));
 	}
 
 	printf("\n");
 }
 
+ResourceListBuilder::Listing &ResourceListBuilder::AddChildListing(Listing &parent)
+{
+	// The child's contents go between the files found so far and the next one
+	parent.children.push_back(std::make_pair(parent.files.size(), std::unique_ptr<Listing>(new Listing)));
+	return *parent.children.back().second;
+}
+
+void ResourceListBuilder::AddFile(Listing &listing, const std::string &name, uint32_t offset, uint32_t length)
+{
+	ListedFile file;
+	file.name = name;
+	file.offset = offset;
+	file.length = length;
+	listing.files.push_back(file);
+}
+
+void ResourceListBuilder::MergeListing(const Listing &listing, int root)
+{
+	printf("%s", listing.messages.c_str());
+
+	const int pak = listing.pakfile.empty() ? -1 : resources.AddPak(listing.pakfile);
+
+	std::vector<std::pair<size_t, std::unique_ptr<Listing> > >::const_iterator childIt = listing.children.begin();
+
+	for (size_t i = 0; i <= listing.files.size(); i++)
+	{
+		// Merge subdirectories and pak files that were found before this file
+		while (childIt != listing.children.end() && childIt->first == i)
+		{
+			MergeListing(*childIt->second, root);
+			++childIt;
+		}
+
+		if (i == listing.files.size())
+		{
+			break;
+		}
+
+		const ListedFile &file = listing.files[i];
+
+		resource_s resource;
+		resource.name = file.name.c_str();
+		resource.root = root;
+		resource.pak = pak;
+		resource.offset = file.offset;
+		resource.length = file.length;
+
+		resources.Add(resource);
+
+		if (resourcedisp)
+		{
+			printf("Added \"%s\" to resource list\n", resource.name);
+		}
+	}
+}
+
 #ifdef _WIN32
 // Win 32 DIR parser
-void ResourceListBuilder::ListDir(const std::string &path, const std::string &filepath, bool reporterror)
+void ResourceListBuilder::ListDir(WorkQueue &queue, const std::string &path, const std::string &filepath, Listing &listing, bool reporterror)
 {
 	WIN32_FIND_DATA filedata;
 
@@ -86,22 +166,20 @@ void ResourceListBuilder::ListDir(const std::string &path, const std::string &fi
 
 	if (filehandle == INVALID_HANDLE_VALUE)
 	{
-		if (firstdir && reporterror)
+		if (reporterror)
 		{
 			if (GetLastError() & ERROR_PATH_NOT_FOUND || GetLastError() & ERROR_FILE_NOT_FOUND)
 			{
-				printf("The directory you specified (%s) can not be found or is empty.\n", path.c_str());
+				appendFormat(listing.messages, "The directory you specified (%s) can not be found or is empty.\n", path.c_str());
 			}
 			else
 			{
-				printf("There was an error with the directory you specified (%s) - ERROR NO: %lu.\n", path.c_str(), GetLastError());
+				appendFormat(listing.messages, "There was an error with the directory you specified (%s) - ERROR NO: %lu.\n", path.c_str(), GetLastError());
 			}
 		}
 		return;
 	}
 
-	firstdir = false;
-
 	do
 	{
 		std::string file = filepath + filedata.cFileName;
@@ -112,8 +190,8 @@ void ResourceListBuilder::ListDir(const std::string &path, const std::string &fi
 			// Look for files in subdir, but ignore . and ..
 			if (strcmp(filedata.cFileName, ".") && strcmp(filedata.cFileName, ".."))
 			{
-				// Call this function recursive
-				ListDir(path, file + PATH_SEPARATOR, reporterror);
+				// List subdir on the queue
+				queue.Add(std::bind(&ResourceListBuilder::ListDir, this, std::ref(queue), path, file + PATH_SEPARATOR, std::ref(AddChildListing(listing)), false));
 			}
 		}
 		else
@@ -139,18 +217,13 @@ void ResourceListBuilder::ListDir(const std::string &path, const std::string &fi
 					// resource, add to list
 					replaceCharAll(file, '\\', '/'); // replace backslashes
 
-					resources[strToLowerCopy(file)] = file;
-
-					if (resourcedisp)
-					{
-						printf("Added \"%s\" to resource list\n", file.c_str());
-					}
+					AddFile(listing, file);
 				}
 
 				if ((extension == "pad") && pakparse)
 				{
-					// get pakfilelist
-					BuildPakResourceList(path + file);
+					// get pakfilelist, parsed while the walk continues
+					queue.Add(std::bind(&ResourceListBuilder::BuildPakResourceList, this, path + file, std::ref(AddChildListing(listing))));
 				}
 			}
 		}
@@ -163,112 +236,147 @@ void ResourceListBuilder::ListDir(const std::string &path, const std::string &fi
 
 #else
 // Linux dir parser
-void ResourceListBuilder::ListDir(const std::string &path, const std::string &filepath, bool reporterror)
+void ResourceListBuilder::ListDir(WorkQueue &queue, const std::string &path, const std::string &filepath, Listing &listing, bool reporterror)
 {
-	struct stat filestatinfo; // Force as a struct for GCC
-
-	std::string searchpath = path + filepath;
+	const std::string searchpath = path + filepath;
 
-	// Open the current dir
-	DIR *directory = opendir(searchpath.c_str());
+	// Directories that haven't changed since the last run aren't listed
+	DirCache::Listing entries;
+	dirstamp_s stamp;
+	const bool stamped = cache && DirCache::GetStamp(searchpath, stamp);
 
-	// Is it open?
-	if (directory == NULL)
+	if (!stamped || !cache->Find("resources", searchpath, stamp, entries))
 	{
-		// dir cannot be opened
-		if (firstdir && reporterror)
+		if (!ReadDir(searchpath, entries))
 		{
-			printf("There was an error with the directory you specified (%s)\nDid you enter the correct directory?\n", path.c_str());
+			// dir cannot be opened
+			if (reporterror)
+			{
+				appendFormat(listing.messages, "There was an error with the directory you specified (%s)\nDid you enter the correct directory?\n", path.c_str());
+			}
+			return;
 		}
-		return;
-	}
 
-	firstdir = false;
+		if (stamped)
+		{
+			cache->Store("resources", searchpath, stamp, entries);
+		}
+	}
 
-	// Start going through dirs finding files.
-	while (true)
+	for (std::vector<direntry_s>::const_iterator it = entries.entries.begin(); it != entries.entries.end(); ++it)
 	{
-		const dirent * const direntry = readdir(directory);
-		if(direntry == NULL)
+		// Do we have a dir?
+		if (it->type == 'd')
 		{
-			break;
+			// List subdir on the queue
+			queue.Add(std::bind(&ResourceListBuilder::ListDir, this, std::ref(queue), path, filepath + it->name + PATH_SEPARATOR, std::ref(AddChildListing(listing)), false));
 		}
+		else if (it->type == 'f')
+		{
+			// resource, add to list
+			std::string file = filepath + it->name;
+			replaceCharAll(file, '\\', '/'); // replace backslashes
 
-		// Do we have a dir?
-		// We follow symlinks. people shouldn't mess with symlinks in the HL folder anyways.
-		int i = stat((searchpath + direntry->d_name).c_str(), &filestatinfo); // Get the info about the files the links point to
+			AddFile(listing, file);
+		}
+		else if (pakparse)
+		{
+			// get pakfilelist, parsed while the walk continues
+			queue.Add(std::bind(&ResourceListBuilder::BuildPakResourceList, this, searchpath + it->name, std::ref(AddChildListing(listing))));
+		}
+	}
+}
 
-		std::string file = filepath + direntry->d_name;
+bool ResourceListBuilder::ReadDir(const std::string &path, DirCache::Listing &entries)
+{
+	// Open the current dir
+	// We follow symlinks. people shouldn't mess with symlinks in the HL folder anyways.
+	DirReader directory;
+	if (!directory.Open(path, true))
+	{
+		return false;
+	}
 
-		if (i == 0)
+	// Start going through dirs finding files.
+	bool isdirectory;
+	while (const char * const name = directory.Next(isdirectory))
+	{
+		direntry_s entry;
+		entry.type = 0;
+		entry.offset = entry.length = 0;
+
+		if (isdirectory)
+		{
+			entry.type = 'd';
+		}
+		else if (const char * const dot = strrchr(name, '.'))
 		{
-			// Check for directory
-			if (S_ISDIR(filestatinfo.st_mode))
+			const std::string extension = strToLowerCopy(dot + 1);
+
+			// Check if the file is a possible resource
+			if (
+				extension == "mdl" ||
+				extension == "wav" ||
+				extension == "spr" ||
+				extension == "bmp" ||
+				extension == "tga" ||
+				extension == "txt" ||
+				extension == "wad"
+			)
 			{
-				// Look for files in subdir, but ignore . and ..
-				if (strcmp(direntry->d_name, ".") && strcmp(direntry->d_name, ".."))
-				{
-					// Call this function recursive
-					ListDir(path, file + PATH_SEPARATOR, reporterror);
-				}
+				entry.type = 'f';
 			}
-			else
+			else if (extension == "pak")
 			{
-				std::string fileLower = strToLowerCopy(file);
-
-				const size_t dotIndex = fileLower.find_last_of('.');
-
-				if(dotIndex != std::string::npos)
-				{
-					const std::string extension = fileLower.substr(dotIndex + 1);
-
-					// Check if the file is a possible resource
-					if (
-						extension == "mdl" ||
-						extension == "wav" ||
-						extension == "spr" ||
-						extension == "bmp" ||
-						extension == "tga" ||
-						extension == "txt" ||
-						extension == "wad"
-					)
-					{
-						// resource, add to list
-						replaceCharAll(file, '\\', '/'); // replace backslashes
-
-						resources[strToLowerCopy(file)] = file;
-
-						if (resourcedisp)
-						{
-							printf("Added \"%s\" to resource list\n", file.c_str());
-						}
-					}
-
-					if ((extension == "pak") && pakparse)
-					{
-						// get pakfilelist
-						BuildPakResourceList(path + file);
-					}
-				}
+				// Kept even with -p, so the cache works without it
+				entry.type = 'p';
 			}
 		}
+
+		// Only entries we keep get a name
+		if (entry.type)
+		{
+			entry.name = name;
+			entries.entries.push_back(entry);
+		}
 	}
 
-	// close the dir
-	closedir(directory);
+	entries.count = entries.entries.size();
+	return true;
 }
 
 #endif
 
-void ResourceListBuilder::BuildPakResourceList(const std::string &pakfilename)
+void ResourceListBuilder::BuildPakResourceList(const std::string &pakfilename, Listing &listing)
 {
+	// Pak files that haven't changed since the last run aren't read
+	DirCache::Listing entries;
+	dirstamp_s stamp;
+	const bool stamped = cache && DirCache::GetStamp(pakfilename, stamp);
+
+	if (stamped && cache->Find("pak", pakfilename, stamp, entries))
+	{
+		listing.pakfile = pakfilename;
+
+		for (std::vector<direntry_s>::const_iterator it = entries.entries.begin(); it != entries.entries.end(); ++it)
+		{
+			AddFile(listing, it->name, it->offset, it->length);
+		}
+
+		if (verbal)
+		{
+			appendFormat(listing.messages, "Scanning pak file \"%s\" for resources (" SIZE_T_SPECIFIER " files in pak, " SIZE_T_SPECIFIER " resources)\n", pakfilename.c_str(), entries.count, listing.files.size());
+		}
+		return;
+	}
+
 	// open the pak file in binary read mode
 	File pakfile(pakfilename, "rb");
 
 	if (pakfile == NULL)
 	{
 		// error opening pakfile!
-		printf("Could not find pakfile \"%s\".\n", pakfilename.c_str());
+		appendFormat(listing.messages, "Could not find pakfile \"%s\".\n", pakfilename.c_str());
 		return;
 	}
 
@@ -283,8 +391,8 @@ void ResourceListBuilder::BuildPakResourceList(const std::string &pakfilename)
 		// unexpected size.
 		if (verbal)
 		{
-			printf("Reading pakfile header failed. Wrong size (" SIZE_T_SPECIFIER " read, " SIZE_T_SPECIFIER " expected).\n", retval, pakheadersize);
-			printf("Is \"%s\" a valid pakfile?\n", pakfilename.c_str());
+			appendFormat(listing.messages, "Reading pakfile header failed. Wrong size (" SIZE_T_SPECIFIER " read, " SIZE_T_SPECIFIER " expected).\n", retval, pakheadersize);
+			appendFormat(listing.messages, "Is \"%s\" a valid pakfile?\n", pakfilename.c_str());
 		}
 		return;
 	}
@@ -294,7 +402,7 @@ void ResourceListBuilder::BuildPakResourceList(const std::string &pakfilename)
 	{
 		if (verbal)
 		{
-			printf("Pakfile \"%s\" does not appear to be a Half-Life pakfile (ID mismatch).\n", pakfilename.c_str());
+			appendFormat(listing.messages, "Pakfile \"%s\" does not appear to be a Half-Life pakfile (ID mismatch).\n", pakfilename.c_str());
 		}
 		return;
 	}
@@ -308,7 +416,7 @@ void ResourceListBuilder::BuildPakResourceList(const std::string &pakfilename)
 	{
 		if (verbal)
 		{
-			printf("Pakfile \"%s\" does not appear to be a Half-Life pakfile (invalid dirsize).\n", pakfilename.c_str());
+			appendFormat(listing.messages, "Pakfile \"%s\" does not appear to be a Half-Life pakfile (invalid dirsize).\n", pakfilename.c_str());
 		}
 		return;
 	}
@@ -318,7 +426,7 @@ void ResourceListBuilder::BuildPakResourceList(const std::string &pakfilename)
 	{
 		if (verbal)
 		{
-			printf("Error seeking for file list.\nPakfile \"%s\" is not a pakfile, or is corrupted.\n", pakfilename.c_str());
+			appendFormat(listing.messages, "Error seeking for file list.\nPakfile \"%s\" is not a pakfile, or is corrupted.\n", pakfilename.c_str());
 		}
 		return;
 	}
@@ -329,20 +437,19 @@ void ResourceListBuilder::BuildPakResourceList(const std::string &pakfilename)
 	{
 		if (verbal)
 		{
-			printf("Error seeking for file list.\nPakfile \"%s\" is not a pakfile, or is corrupted.\n", pakfilename.c_str());
+			appendFormat(listing.messages, "Error seeking for file list.\nPakfile \"%s\" is not a pakfile, or is corrupted.\n", pakfilename.c_str());
 		}
 		return;
 	}
 
-	if (verbal)
-	{
-		printf("Scanning pak file \"%s\" for resources (" SIZE_T_SPECIFIER " files in pak)\n", pakfilename.c_str(), filecount);
-	}
+	listing.pakfile = pakfilename;
 
 	// Read filelist for possible resources
 	for (size_t i = 0; i < filecount; i++)
 	{
-		const std::string fileLower = strToLowerCopy(filelist[i].name);
+		// The name isn't always NUL terminated
+		const std::string fileName(filelist[i].name, strnlen(filelist[i].name, sizeof(filelist[i].name)));
+		const std::string fileLower = strToLowerCopy(fileName);
 
 		const size_t dotIndex = fileLower.find_last_of('.');
 
@@ -361,15 +468,33 @@ void ResourceListBuilder::BuildPakResourceList(const std::string &pakfilename)
 			)
 			{
 				// resource, add to list
-				std::string resStr = replaceCharAllCopy(filelist[i].name, '\\', '/');
-
-				resources[strToLowerCopy(resStr)] = resStr;
+				std::string resStr = replaceCharAllCopy(fileName, '\\', '/');
 
-				if (resourcedisp)
-				{
-					printf("Added \"%s\" to resource list\n", resStr.c_str());
-				}
+				// Entries are read straight from the pak
+				AddFile(listing, resStr, filelist[i].fileoffset, filelist[i].filelen);
 			}
 		}
 	}
+
+	if (verbal)
+	{
+		appendFormat(listing.messages, "Scanning pak file \"%s\" for resources (" SIZE_T_SPECIFIER " files in pak, " SIZE_T_SPECIFIER " resources)\n", pakfilename.c_str(), filecount, listing.files.size());
+	}
+
+	if (stamped)
+	{
+		entries.count = filecount;
+
+		for (std::vector<ListedFile>::const_iterator it = listing.files.begin(); it != listing.files.end(); ++it)
+		{
+			direntry_s entry;
+			entry.type = 'f';
+			entry.name = it->name;
+			entry.offset = it->offset;
+			entry.length = it->length;
+			entries.entries.push_back(entry);
+		}
+
+		cache->Store("pak", pakfilename, stamp, entries);
+	}
 }
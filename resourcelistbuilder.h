@@ -22,39 +22,74 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #ifndef RESOURCELISTBUILDER_H
 #define RESOURCELISTBUILDER_H
 
+#include <cstddef>
 #include <map>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "dircache.h"
+#include "resourceindex.h"
 #include "util.h"
 
+class WorkQueue;
+
 class ResourceListBuilder
 {
 public:
-	typedef std::map<std::string, std::string> StringMap;
-
 	ResourceListBuilder(const config_s &config);
 	void BuildResourceList(const std::vector<std::string> &paths, bool checkpak, bool rdisp);
+	void SetCache(DirCache *dircache);
 
 private:
+	// A resource until it is added to the index, which keeps its own copy
+	// of the name
+	struct ListedFile
+	{
+		std::string name; // Case as found on disk
+		uint32_t offset; // Pak entries only
+		uint32_t length; // Pak entries only
+	};
+
+	// Resources found in a single directory or pak file. Subdirectories are
+	// listed concurrently, so their contents end up in child listings, along
+	// with their position between the files of the parent. Merging the tree
+	// depth first adds resources in the same order as a serial directory walk.
+	struct Listing
+	{
+		std::string messages; // Printed when the listing is merged
+		std::string pakfile; // Set if the files are entries of this pak file
+		std::vector<ListedFile> files;
+		std::vector<std::pair<size_t, std::unique_ptr<Listing> > > children;
+	};
+
+	static Listing &AddChildListing(Listing &parent);
+	static void AddFile(Listing &listing, const std::string &name, uint32_t offset = 0, uint32_t length = 0);
+
 	#ifdef _WIN32
 	// Win 32 DIR parser
-	void ListDir(const std::string &path, const std::string &filepath, bool reporterror);
+	void ListDir(WorkQueue &queue, const std::string &path, const std::string &filepath, Listing &listing, bool reporterror);
 	#else
 	// Linux dir parser
-	void ListDir(const std::string &path, const std::string &filepath, bool reporterror);
+	void ListDir(WorkQueue &queue, const std::string &path, const std::string &filepath, Listing &listing, bool reporterror);
+	static bool ReadDir(const std::string &path, DirCache::Listing &entries);
 	#endif
 
-	void BuildPakResourceList(const std::string &pakfilename);
+	void BuildPakResourceList(const std::string &pakfilename, Listing &listing);
+
+	void MergeListing(const Listing &listing, int root);
 
 	bool resourcedisp;
 	bool pakparse;
-	bool firstdir;
 
 	bool verbal;
+	unsigned int jobs;
+	DirCache *cache; // Unchanged directories and pak files aren't read again if set
 
 // TODO: Make private
 public:
-	StringMap resources;
+	ResourceIndex resources;
 };
 
 #endif
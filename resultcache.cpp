@@ -0,0 +1,134 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "resultcache.h"
+#include "reswriter.h"
+#include "util.h"
+
+#define RESULTCACHE_HEADER "RESGen result 2"
+
+ResultCache::ResultCache(const std::string &folder_, const std::string &settings)
+	: folder(folder_)
+	, settingsHash(hashData(settings.data(), settings.length()))
+{
+	EndWithPathSep(folder);
+}
+
+std::string ResultCache::MakeKey(const char *entdata, size_t entlength) const
+{
+	// The length as well, to make a collision even less likely
+	std::string key;
+	appendFormat(key, "%016llx-%llx", hashData(entdata, entlength, settingsHash), static_cast<unsigned long long>(entlength));
+	return key;
+}
+
+bool ResultCache::Find(const std::string &key, NameList &resfile) const
+{
+	std::string str;
+	if (!readFile(GetFileName(key), str))
+	{
+		return false;
+	}
+
+	// The header, the number of entries and the entries, each line ended by
+	// a newline. Anything else, like a file cut short, is treated as a miss.
+	if (str.empty() || str[str.length() - 1] != '\n')
+	{
+		return false;
+	}
+
+	Tokenizer<'\n'> tokenizer(str);
+	const char *token = tokenizer.Next();
+
+	if (!token || strcmp(token, RESULTCACHE_HEADER) || !(token = tokenizer.Next()))
+	{
+		return false;
+	}
+
+	char *end;
+	const unsigned long count = strtoul(token, &end, 10);
+	if (*token == 0 || *end != 0)
+	{
+		return false;
+	}
+
+	std::vector<const char*> names;
+	for (unsigned long i = 0; i < count; i++)
+	{
+		token = tokenizer.Next();
+		if (!token || *token == 0)
+		{
+			return false;
+		}
+
+		names.push_back(token);
+	}
+
+	token = tokenizer.Next();
+	if (token && *token != 0)
+	{
+		return false;
+	}
+
+	resfile.Clear();
+	for (std::vector<const char*>::const_iterator it = names.begin(); it != names.end(); ++it)
+	{
+		resfile.Add(*it, strlen(*it));
+	}
+
+	return true;
+}
+
+void ResultCache::Store(const std::string &key, const NameList &resfile) const
+{
+	std::string contents = RESULTCACHE_HEADER "\n";
+	appendFormat(contents, SIZE_T_SPECIFIER "\n", resfile.Size());
+
+	for (size_t i = 0; i < resfile.Count(); i++)
+	{
+		const NameList::Entry &entry = resfile[i];
+		if (entry.erased)
+		{
+			continue;
+		}
+
+		if (entry.name.find_first_of("\r\n") != std::string::npos)
+		{
+			// Can't be stored, this map is just parsed every time
+			return;
+		}
+
+		contents += entry.name;
+		contents += '\n';
+	}
+
+	// A failure only means the next run parses the map again
+	std::string error;
+	ResWriter::WriteResFile(GetFileName(key), contents, error);
+}
+
+std::string ResultCache::GetFileName(const std::string &key) const
+{
+	return folder + key + ".lst";
+}
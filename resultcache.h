@@ -0,0 +1,56 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <cstddef>
+#include <string>
+
+#include "namelist.h"
+
+// Resource lists of entity lumps parsed before, one file per list in a
+// folder that several runs, or servers, may share. Lists are found by a hash
+// of the entity lump and the settings that change the list, so maps that
+// are the same on every server are only parsed once. Files are replaced in
+// one step, and the cache holds no other state, so it can be used by several
+// threads and processes at once.
+class ResultCache
+{
+public:
+	ResultCache(const std::string &folder, const std::string &settings);
+
+	std::string MakeKey(const char *entdata, size_t entlength) const;
+
+	// Fills resfile like parsing the entity lump would, in the same order
+	bool Find(const std::string &key, NameList &resfile) const;
+
+	// Names are stored in the order of resfile
+	void Store(const std::string &key, const NameList &resfile) const;
+
+private:
+	std::string GetFileName(const std::string &key) const;
+
+	std::string folder; // Ends with a path separator
+	unsigned long long settingsHash;
+};
+
+#endif // RESULTCACHE_H
@@ -0,0 +1,431 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+// RESGen does it's own security checks, no need to add VS2005's layer
+#define _CRT_SECURE_NO_DEPRECATE
+
+#include <atomic>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "reswriter.h"
+#include "util.h"
+
+// Written files are synced and renamed once this many are waiting
+#define SYNC_BATCH 64
+
+namespace
+{
+	std::atomic<unsigned int> tempCounter(0);
+
+	// Name to write fileName's new contents to before it is renamed. Unique
+	// per process and write, so other writers of the same file, in this
+	// run or another, never write to the same temporary file.
+	std::string TempName(const std::string &fileName)
+	{
+	#ifdef _WIN32
+		const unsigned long pid = GetCurrentProcessId();
+	#else
+		const unsigned long pid = static_cast<unsigned long>(getpid());
+	#endif
+
+		std::string tempName(fileName);
+		appendFormat(tempName, ".%lu-%u.tmp", pid, tempCounter++);
+		return tempName;
+	}
+
+	// File a rename over fileName has to replace, so a symlinked res file
+	// stays a symlink. Broken links are replaced themselves.
+	std::string LinkTarget(const std::string &fileName)
+	{
+	#ifndef _WIN32
+		struct stat filestatinfo; // Force as a struct for GCC
+		if (!lstat(fileName.c_str(), &filestatinfo) && S_ISLNK(filestatinfo.st_mode))
+		{
+			char *resolved = realpath(fileName.c_str(), NULL);
+			if (resolved != NULL)
+			{
+				const std::string target(resolved);
+				free(resolved);
+				return target;
+			}
+		}
+	#endif
+
+		return fileName;
+	}
+
+	// rename, but replaces an existing file on Windows too
+	bool RenameOver(const std::string &from, const std::string &to)
+	{
+	#ifdef _WIN32
+		return MoveFileEx(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+	#else
+		return rename(from.c_str(), to.c_str()) == 0;
+	#endif
+	}
+
+	// Flushes files or directories to disk. On Linux every file system is
+	// synced once for the whole batch, elsewhere each file on its own.
+	bool SyncPaths(const std::vector<std::string> &paths)
+	{
+		bool success = true;
+
+	#ifndef _WIN32
+		std::set<dev_t> synced;
+
+		for (std::vector<std::string>::const_iterator it = paths.begin(); it != paths.end(); ++it)
+		{
+			const int fd = open(it->c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd < 0)
+			{
+				success = false;
+				continue;
+			}
+
+		#ifdef __linux__
+			struct stat filestatinfo; // Force as a struct for GCC
+			if (fstat(fd, &filestatinfo) || synced.insert(filestatinfo.st_dev).second)
+			{
+				success = !syncfs(fd) && success;
+			}
+		#else
+			success = !fsync(fd) && success;
+		#endif
+
+			close(fd);
+		}
+	#else
+		// MoveFileEx doesn't offer a cheap way, Windows files aren't synced
+		(void)paths;
+	#endif
+
+		return success;
+	}
+}
+
+ResWriter::ResWriter(size_t maxQueued, bool sync)
+	: maxJobs(maxQueued)
+	, syncFiles(sync)
+	, busy(false)
+	, stopping(false)
+{
+	// Start the thread last, everything it uses has been set up now
+	thread = std::thread(&ResWriter::Run, this);
+}
+
+ResWriter::~ResWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	jobAdded.notify_all();
+	thread.join();
+}
+
+void ResWriter::Write(int id, const std::string &fileName, std::string &contents)
+{
+	Job job;
+	job.id = id;
+	job.remove = false;
+	job.fileName = fileName;
+	job.contents.swap(contents);
+
+	Add(job);
+}
+
+void ResWriter::Remove(const std::string &fileName)
+{
+	Job job;
+	job.id = 0;
+	job.remove = true;
+	job.fileName = fileName;
+
+	Add(job);
+}
+
+void ResWriter::Wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (busy || !jobs.empty())
+	{
+		jobDone.wait(lock);
+	}
+}
+
+std::vector<ResWriter::Failure> ResWriter::GetFailures()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return failures;
+}
+
+void ResWriter::Add(Job &job)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	// Don't let the queue grow without bounds if the disk can't keep up
+	while (jobs.size() >= maxJobs)
+	{
+		jobDone.wait(lock);
+	}
+
+	jobs.push_back(std::move(job));
+
+	lock.unlock();
+	jobAdded.notify_one();
+}
+
+void ResWriter::Run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	// while(true) incorrectly triggers MSVC C4127
+	for(;;)
+	{
+		if (jobs.empty())
+		{
+			if (stopping)
+			{
+				return;
+			}
+
+			jobAdded.wait(lock);
+			continue;
+		}
+
+		Job job(std::move(jobs.front()));
+		jobs.pop_front();
+		busy = true;
+
+		lock.unlock();
+
+		std::string error;
+		bool success = true;
+
+		if (job.remove)
+		{
+			// Never reorder a removal with a pending rename
+			CommitPending();
+			remove(job.fileName.c_str());
+		}
+		else if (!syncFiles)
+		{
+			success = WriteResFile(job.fileName, job.contents, error);
+		}
+		else if (!IsUnchanged(job.fileName, job.contents))
+		{
+			const Pending written(Prepare(job.id, job.fileName));
+
+			success = WriteTemp(written, job.contents, error);
+			if (success)
+			{
+				pending.push_back(written);
+			}
+		}
+
+		lock.lock();
+
+		if (!success)
+		{
+			Failure failure;
+			failure.id = job.id;
+			failure.message = error;
+			failures.push_back(failure);
+		}
+
+		// Sync when the batch is full, or when there's nothing left to batch
+		// it with. Wait returns after that, with every file in place.
+		if (!pending.empty() && (pending.size() >= SYNC_BATCH || jobs.empty()))
+		{
+			lock.unlock();
+			CommitPending();
+			lock.lock();
+		}
+
+		busy = false;
+		jobDone.notify_all();
+	}
+}
+
+void ResWriter::CommitPending()
+{
+	if (pending.empty())
+	{
+		return;
+	}
+
+	std::vector<std::string> paths;
+	for (std::vector<Pending>::const_iterator it = pending.begin(); it != pending.end(); ++it)
+	{
+		paths.push_back(it->tempName);
+	}
+
+	// Contents first, so a renamed file is never empty after a crash
+	const bool synced = SyncPaths(paths);
+
+	paths.clear();
+	std::vector<Failure> renameFailures;
+	std::vector<Pending> renamed;
+
+	for (std::vector<Pending>::const_iterator it = pending.begin(); it != pending.end(); ++it)
+	{
+		if (!RenameOver(it->tempName, it->target))
+		{
+			Failure failure;
+			failure.id = it->id;
+			appendFormat(failure.message, "Failed to replace %s.\n", it->fileName.c_str());
+			renameFailures.push_back(failure);
+
+			remove(it->tempName.c_str());
+			continue;
+		}
+
+		// Then the directory entries
+		std::string folder;
+		std::string name;
+		splitPath(it->target, folder, name);
+		paths.push_back(folder);
+		renamed.push_back(*it);
+	}
+
+	// A failed sync may have hit any file of the batch, so all of them are
+	// reported
+	if (!SyncPaths(paths) || !synced)
+	{
+		for (std::vector<Pending>::const_iterator it = renamed.begin(); it != renamed.end(); ++it)
+		{
+			Failure failure;
+			failure.id = it->id;
+			appendFormat(failure.message, "Failed to sync %s to disk.\n", it->fileName.c_str());
+			renameFailures.push_back(failure);
+		}
+	}
+
+	pending.clear();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	failures.insert(failures.end(), renameFailures.begin(), renameFailures.end());
+}
+
+bool ResWriter::WriteResFile(const std::string &fileName, const std::string &contents, std::string &error)
+{
+	if (IsUnchanged(fileName, contents))
+	{
+		return true;
+	}
+
+	const Pending written(Prepare(0, fileName));
+
+	if (!WriteTemp(written, contents, error))
+	{
+		return false;
+	}
+
+	if (!RenameOver(written.tempName, written.target))
+	{
+		remove(written.tempName.c_str());
+		appendFormat(error, "Failed to replace %s.\n", fileName.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool ResWriter::IsUnchanged(const std::string &fileName, const std::string &contents)
+{
+	// Text mode, like it is written
+	File f(fileName, "r");
+
+	if (f == NULL)
+	{
+		return false;
+	}
+
+	// One more byte than needed, to see if the file is longer
+	std::string existing(contents.length() + 1, '\0');
+	const size_t length = fread(&existing[0], 1, existing.length(), f);
+
+	return length == contents.length() && !existing.compare(0, length, contents);
+}
+
+ResWriter::Pending ResWriter::Prepare(int id, const std::string &fileName)
+{
+	Pending written;
+	written.id = id;
+	written.fileName = fileName;
+	written.target = LinkTarget(fileName);
+	written.tempName = TempName(written.target);
+	return written;
+}
+
+bool ResWriter::WriteTemp(const Pending &written, const std::string &contents, std::string &error)
+{
+	// Text mode, like the old fprintf based writer
+	File f(written.tempName, "w");
+
+	if (f == NULL)
+	{
+		appendFormat(error, "Failed to open %s for writing.\n", written.fileName.c_str());
+		return false;
+	}
+
+#ifndef _WIN32
+	// The temporary file replaces the old one, so it takes over its owner and
+	// mode. Only root may give files away, others keep at least the group.
+	struct stat filestatinfo; // Force as a struct for GCC
+	if (!stat(written.target.c_str(), &filestatinfo))
+	{
+		const int fd = fileno(f);
+		const bool owned =
+			!fchown(fd, filestatinfo.st_uid, filestatinfo.st_gid)
+		||	!fchown(fd, static_cast<uid_t>(-1), filestatinfo.st_gid);
+
+		// Owner first, changing it may clear the setuid and setgid bits
+		fchmod(fd, filestatinfo.st_mode & (owned ? 07777 : 0777));
+	}
+#endif
+
+	if (
+		(fwrite(contents.data(), 1, contents.length(), f) != contents.length())
+	||	fflush(f)
+	)
+	{
+		f.close();
+		remove(written.tempName.c_str());
+		appendFormat(error, "Failed to write %s.\n", written.fileName.c_str());
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,110 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef RESWRITER_H
+#define RESWRITER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes and removes res files on a background thread, so slow disks don't
+// stall map processing. Jobs are done in the order they were queued.
+//
+// Files that already have the new contents aren't touched, so their mtime
+// stays the same and mirrors don't transfer them again. Others are written
+// to a temporary file that is renamed over the res file, so readers never
+// see a partly written one.
+class ResWriter
+{
+public:
+	struct Failure
+	{
+		int id;
+		std::string message;
+	};
+
+	// Blocks new jobs while maxQueued jobs are waiting. If sync is set the
+	// files are flushed to disk before they are renamed, in batches.
+	ResWriter(size_t maxQueued, bool sync);
+	~ResWriter();
+
+	// Writes a res file on the calling thread, without syncing it
+	static bool WriteResFile(const std::string &fileName, const std::string &contents, std::string &error);
+
+	// Writes contents to fileName. Takes over contents, leaving it empty.
+	// id is used to report failures.
+	void Write(int id, const std::string &fileName, std::string &contents);
+	void Remove(const std::string &fileName);
+
+	// Blocks until all queued jobs are done
+	void Wait();
+
+	// Failed jobs so far, in the order they failed
+	std::vector<Failure> GetFailures();
+
+private:
+	ResWriter(const ResWriter &other);
+	ResWriter& operator=(const ResWriter &other);
+
+	struct Job
+	{
+		int id;
+		bool remove;
+		std::string fileName;
+		std::string contents;
+	};
+
+	// Written file waiting to be synced and renamed
+	struct Pending
+	{
+		int id;
+		std::string tempName;
+		std::string fileName;
+		std::string target; // fileName, or the file its symlink points to
+	};
+
+	void Add(Job &job);
+	void Run();
+	void CommitPending();
+
+	static bool IsUnchanged(const std::string &fileName, const std::string &contents);
+	static Pending Prepare(int id, const std::string &fileName);
+	static bool WriteTemp(const Pending &written, const std::string &contents, std::string &error);
+
+	size_t maxJobs;
+	bool syncFiles;
+	std::vector<Pending> pending; // Writer thread only
+	std::mutex mutex;
+	std::condition_variable jobAdded;
+	std::condition_variable jobDone;
+	std::deque<Job> jobs;
+	bool busy;
+	bool stopping;
+	std::vector<Failure> failures;
+	std::thread thread;
+};
+
+#endif
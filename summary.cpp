@@ -0,0 +1,227 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "summary.h"
+#include "util.h"
+
+#define SUMMARY_HEADER "RESGen summary 1"
+
+namespace
+{
+	void WriteResults(FILE *f, const char *type, const std::vector<mapresult_s> &results)
+	{
+		for (std::vector<mapresult_s>::const_iterator it = results.begin(); it != results.end(); ++it)
+		{
+			fprintf(f, "%s " SIZE_T_SPECIFIER " %s\n", type, it->position, it->name.c_str());
+		}
+	}
+
+	// Parses "<position> <name>"
+	bool ParseResult(const char *str, std::vector<mapresult_s> &results)
+	{
+		char *end;
+		const unsigned long long position = strtoull(str, &end, 10);
+		if (end == str || *end != ' ')
+		{
+			return false;
+		}
+
+		mapresult_s result;
+		result.position = static_cast<size_t>(position);
+		result.name = end + 1;
+		results.push_back(result);
+		return true;
+	}
+
+	bool PositionLess(const mapresult_s &a, const mapresult_s &b)
+	{
+		return a.position < b.position;
+	}
+}
+
+bool WriteSummary(const std::string &filename, const summary_s &summary)
+{
+	File f(filename, "w");
+
+	if (f == NULL)
+	{
+		printf("Error: Could not open summary file %s for writing!\n", filename.c_str());
+		return false;
+	}
+
+	fprintf(f, SUMMARY_HEADER "\n");
+	fprintf(f, "shard %u %u\n", summary.shard, summary.shardcount);
+	fprintf(f, "maps " SIZE_T_SPECIFIER " " SIZE_T_SPECIFIER "\n", summary.totalmaps, summary.mapcount);
+	WriteResults(f, "error", summary.errors);
+	WriteResults(f, "missing", summary.missing);
+
+	if (fflush(f) != 0 || ferror(f))
+	{
+		printf("Error: Could not write summary file %s!\n", filename.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool ReadSummary(const std::string &filename, summary_s &summary)
+{
+	std::string str;
+	if (!readFile(filename, str))
+	{
+		printf("Error: Could not open summary file %s!\n", filename.c_str());
+		return false;
+	}
+
+	summary.shard = 0;
+	summary.shardcount = 0;
+	summary.totalmaps = 0;
+	summary.mapcount = 0;
+	summary.errors.clear();
+	summary.missing.clear();
+
+	Tokenizer<'\n'> tokenizer(str);
+	bool valid = true;
+	bool header = true;
+	bool foundmaps = false;
+
+	for (const char *token = tokenizer.Next(); token && valid; token = tokenizer.Next())
+	{
+		std::string line = token;
+		rightTrim(line, "\r");
+
+		if (header)
+		{
+			valid = (line == SUMMARY_HEADER);
+			header = false;
+		}
+		else if (line.empty())
+		{
+			continue;
+		}
+		else if (!line.compare(0, 6, "shard "))
+		{
+			valid = (sscanf(line.c_str() + 6, "%u %u", &summary.shard, &summary.shardcount) == 2);
+		}
+		else if (!line.compare(0, 5, "maps "))
+		{
+			char *end;
+			summary.totalmaps = static_cast<size_t>(strtoull(line.c_str() + 5, &end, 10));
+			summary.mapcount = static_cast<size_t>(strtoull(end, NULL, 10));
+			foundmaps = true;
+		}
+		else if (!line.compare(0, 6, "error "))
+		{
+			valid = ParseResult(line.c_str() + 6, summary.errors);
+		}
+		else if (!line.compare(0, 8, "missing "))
+		{
+			valid = ParseResult(line.c_str() + 8, summary.missing);
+		}
+		else
+		{
+			valid = false;
+		}
+	}
+
+	if (!valid || header || !foundmaps || summary.shard < 1 || summary.shard > summary.shardcount)
+	{
+		printf("Error: %s is not a valid RESGen summary file!\n", filename.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool MergeSummaries(const std::vector<std::string> &filenames, summary_s &merged)
+{
+	merged.shard = 1;
+	merged.shardcount = 1;
+	merged.totalmaps = 0;
+	merged.mapcount = 0;
+	merged.errors.clear();
+	merged.missing.clear();
+
+	std::vector<bool> seen;
+
+	for (std::vector<std::string>::const_iterator it = filenames.begin(); it != filenames.end(); ++it)
+	{
+		summary_s summary;
+		if (!ReadSummary(*it, summary))
+		{
+			return false;
+		}
+
+		if (it == filenames.begin())
+		{
+			merged.totalmaps = summary.totalmaps;
+			seen.assign(summary.shardcount, false);
+		}
+		else if (summary.shardcount != seen.size() || summary.totalmaps != merged.totalmaps)
+		{
+			printf("Error: %s is not from the same run as %s!\n", it->c_str(), filenames.front().c_str());
+			return false;
+		}
+
+		if (seen[summary.shard - 1])
+		{
+			printf("Error: Summary of shard %u/%u was given more than once!\n", summary.shard, summary.shardcount);
+			return false;
+		}
+		seen[summary.shard - 1] = true;
+
+		merged.mapcount += summary.mapcount;
+		merged.errors.insert(merged.errors.end(), summary.errors.begin(), summary.errors.end());
+		merged.missing.insert(merged.missing.end(), summary.missing.begin(), summary.missing.end());
+	}
+
+	bool complete = true;
+	for (size_t i = 0; i < seen.size(); i++)
+	{
+		if (!seen[i])
+		{
+			printf("Error: Summary of shard " SIZE_T_SPECIFIER "/" SIZE_T_SPECIFIER " is missing!\n", i + 1, seen.size());
+			complete = false;
+		}
+	}
+
+	if (!complete)
+	{
+		return false;
+	}
+
+	if (merged.mapcount != merged.totalmaps)
+	{
+		printf("Error: The shard summaries don't add up to " SIZE_T_SPECIFIER " maps!\n", merged.totalmaps);
+		return false;
+	}
+
+	// Every map belongs to one shard, so this restores the order of a single run
+	std::sort(merged.errors.begin(), merged.errors.end(), PositionLess);
+	std::sort(merged.missing.begin(), merged.missing.end(), PositionLess);
+
+	return true;
+}
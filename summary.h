@@ -0,0 +1,54 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct mapresult_s
+{
+	size_t position; // Index in the map list before sharding
+	std::string name;
+};
+
+// Outcome of a run, written with --summary so the runs of all shards can be
+// combined into one report with --merge
+struct summary_s
+{
+	unsigned int shard; // 1 based
+	unsigned int shardcount;
+	size_t totalmaps; // Maps found before sharding
+	size_t mapcount; // Maps in this shard
+	std::vector<mapresult_s> errors; // Maps that failed, by position
+	std::vector<mapresult_s> missing; // Maps with missing resources, by position
+};
+
+bool WriteSummary(const std::string &filename, const summary_s &summary);
+bool ReadSummary(const std::string &filename, summary_s &summary);
+
+// Combines the summaries of all shards of one run. Reports what is wrong and
+// returns false if any shard is missing or doesn't belong to the same run.
+bool MergeSummaries(const std::vector<std::string> &filenames, summary_s &merged);
+
+#endif // SUMMARY_H
@@ -0,0 +1,107 @@
+#include <string>
+#include <time.h>
+#include <utime.h>
+#include <vector>
+
+#include "test.h"
+#include "assetstore.h"
+#include "util.h"
+
+class AssetStoreTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(AssetStoreTest);
+    CPPUNIT_TEST(testReadBack);
+    CPPUNIT_TEST(testTruncated);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void testReadBack()
+    {
+        const std::string file = WriteStore("readback");
+
+        AssetStore store;
+        CPPUNIT_ASSERT(store.Load(file));
+
+        AssetStore::TextureSet textures;
+        CPPUNIT_ASSERT(store.FindWad(testPath("readback.wad"), 0, textures));
+        CPPUNIT_ASSERT(textures.Contains("aaatrigger"));
+        CPPUNIT_ASSERT(textures.Contains("{fence"));
+        CPPUNIT_ASSERT(!textures.Contains("sky"));
+
+        bool exttexture = false;
+        CPPUNIT_ASSERT(store.FindModel(testPath("readback.mdl"), 0, exttexture));
+        CPPUNIT_ASSERT(exttexture);
+    }
+
+    void testTruncated()
+    {
+        const std::string file = WriteStore("truncated");
+
+        std::string contents;
+        CPPUNIT_ASSERT(readFile(file, contents));
+
+        // Without the end marker
+        CheckIgnored(file, contents.substr(0, contents.rfind("end\n")));
+
+        // A texture name of the WAD went missing
+        const size_t firstTexture = contents.find("\nt ") + 1;
+        const size_t textureEnd = contents.find('\n', firstTexture) + 1;
+        CheckIgnored(file, contents.substr(0, firstTexture) + contents.substr(textureEnd));
+
+        // Cut off in the middle of a line
+        CheckIgnored(file, contents.substr(0, firstTexture + 4));
+    }
+
+private:
+    // Written long enough ago to be trusted
+    static void WriteOldFile(const std::string &path)
+    {
+        writeTestFile(path, "asset");
+
+        struct utimbuf times;
+        times.actime = time(NULL) - 1000;
+        times.modtime = times.actime;
+        CPPUNIT_ASSERT(utime(path.c_str(), &times) == 0);
+    }
+
+    static std::string WriteStore(const std::string &name)
+    {
+        const std::string wad = testPath(name + ".wad");
+        const std::string mdl = testPath(name + ".mdl");
+        WriteOldFile(wad);
+        WriteOldFile(mdl);
+
+        std::vector<std::string> names;
+        names.push_back("aaatrigger");
+        names.push_back("{fence");
+
+        AssetStore::TextureSet textures;
+        textures.Assign(names);
+
+        AssetStore store;
+        store.StoreWad(wad, 0, textures);
+        store.StoreModel(mdl, 0, true);
+
+        const std::string file = testPath(name + ".assets");
+        CPPUNIT_ASSERT(store.Save(file));
+        return file;
+    }
+
+    static void CheckIgnored(const std::string &file, const std::string &contents)
+    {
+        const std::string ignored = file + ".ignored";
+        writeTestFile(ignored, contents);
+
+        // Nothing is lost by ignoring it, the assets are just parsed again
+        AssetStore store;
+        CPPUNIT_ASSERT(store.Load(ignored));
+
+        const std::string name = file.substr(0, file.length() - 7);
+        AssetStore::TextureSet textures;
+        bool exttexture;
+        CPPUNIT_ASSERT(!store.FindWad(name + ".wad", 0, textures));
+        CPPUNIT_ASSERT(!store.FindModel(name + ".mdl", 0, exttexture));
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(AssetStoreTest);
@@ -0,0 +1,117 @@
+#include <string>
+
+#include "test.h"
+#include "dircache.h"
+#include "util.h"
+
+class DirCacheTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(DirCacheTest);
+    CPPUNIT_TEST(testReadBack);
+    CPPUNIT_TEST(testTruncated);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void testReadBack()
+    {
+        const std::string file = WriteCache("readback.cache");
+
+        DirCache cache;
+        CPPUNIT_ASSERT(cache.Load(file));
+
+        DirCache::Listing listing;
+        CPPUNIT_ASSERT(cache.Find("dir", "mod/sound/", Stamp(), listing));
+        CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(2), listing.entries.size());
+        CPPUNIT_ASSERT_EQUAL(std::string("a.wav"), listing.entries[0].name);
+        CPPUNIT_ASSERT_EQUAL(std::string("with space.wav"), listing.entries[1].name);
+
+        CPPUNIT_ASSERT(cache.Find("pak", "mod/pak0.pak", Stamp(), listing));
+        CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(3), listing.count);
+        CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(1), listing.entries.size());
+        CPPUNIT_ASSERT_EQUAL(static_cast<uint32_t>(12), listing.entries[0].offset);
+
+        // Another stamp means the folder changed
+        dirstamp_s other = Stamp();
+        other.mtime++;
+        CPPUNIT_ASSERT(!cache.Find("dir", "mod/sound/", other, listing));
+    }
+
+    void testTruncated()
+    {
+        const std::string file = WriteCache("truncated.cache");
+
+        std::string contents;
+        CPPUNIT_ASSERT(readFile(file, contents));
+
+        // Without the end marker
+        CheckIgnored(file, contents.substr(0, contents.rfind("end\n")));
+
+        // Cut off after a complete entry of the first listing
+        const size_t firstEntry = contents.find("\ne ") + 1;
+        CheckIgnored(file, contents.substr(0, contents.find('\n', firstEntry) + 1));
+
+        // An entry of a listing went missing
+        const size_t entryEnd = contents.find('\n', firstEntry) + 1;
+        CheckIgnored(file, contents.substr(0, firstEntry) + contents.substr(entryEnd));
+
+        // Cut off in the middle of a line
+        CheckIgnored(file, contents.substr(0, firstEntry + 4));
+    }
+
+private:
+    static dirstamp_s Stamp()
+    {
+        dirstamp_s stamp;
+        stamp.inode = 1;
+        stamp.size = 2;
+        stamp.mtime = 3;
+        stamp.mtimensec = 4;
+        return stamp;
+    }
+
+    static direntry_s Entry(char type, const std::string &name, uint32_t offset)
+    {
+        direntry_s entry;
+        entry.type = type;
+        entry.name = name;
+        entry.offset = offset;
+        entry.length = 0;
+        return entry;
+    }
+
+    static std::string WriteCache(const std::string &name)
+    {
+        DirCache::Listing folder;
+        folder.count = 0;
+        folder.entries.push_back(Entry('f', "a.wav", 0));
+        folder.entries.push_back(Entry('f', "with space.wav", 0));
+
+        DirCache::Listing pak;
+        pak.count = 3;
+        pak.entries.push_back(Entry('f', "sound/b.wav", 12));
+
+        DirCache cache;
+        cache.Store("dir", "mod/sound/", Stamp(), folder);
+        cache.Store("pak", "mod/pak0.pak", Stamp(), pak);
+
+        const std::string file = testPath(name);
+        CPPUNIT_ASSERT(cache.Save(file));
+        return file;
+    }
+
+    static void CheckIgnored(const std::string &file, const std::string &contents)
+    {
+        const std::string ignored = file + ".ignored";
+        writeTestFile(ignored, contents);
+
+        // Nothing is lost by ignoring it, every folder is just listed again
+        DirCache cache;
+        CPPUNIT_ASSERT(cache.Load(ignored));
+
+        DirCache::Listing listing;
+        CPPUNIT_ASSERT(!cache.Find("dir", "mod/sound/", Stamp(), listing));
+        CPPUNIT_ASSERT(!cache.Find("pak", "mod/pak0.pak", Stamp(), listing));
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DirCacheTest);
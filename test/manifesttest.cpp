@@ -0,0 +1,180 @@
+#include <string>
+#include <time.h>
+#include <utime.h>
+#include <vector>
+
+#include "test.h"
+#include "manifest.h"
+#include "util.h"
+
+class ManifestTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(ManifestTest);
+    CPPUNIT_TEST(testReadBack);
+    CPPUNIT_TEST(testChangedDependency);
+    CPPUNIT_TEST(testOtherSettings);
+    CPPUNIT_TEST(testTruncated);
+    CPPUNIT_TEST(testInvalidFile);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void testReadBack()
+    {
+        const std::string file = WriteManifest("readback");
+
+        Manifest manifest;
+        CPPUNIT_ASSERT(manifest.Load(file, "settings"));
+
+        int status = -1;
+        CPPUNIT_ASSERT(manifest.IsUpToDate(Path("readback.bsp"), Path("readback.res"), ResourceIndex(), status));
+        CPPUNIT_ASSERT_EQUAL(2, status);
+    }
+
+    void testChangedDependency()
+    {
+        const std::string file = WriteManifest("changed");
+
+        // Now a resource the map looked up and didn't find exists
+        ResourceIndex resources;
+        const int mod = resources.AddRoot("mod/");
+        resource_s resource;
+        resource.name = "sound/missing.wav";
+        resource.root = mod;
+        resource.pak = -1;
+        resource.offset = 0;
+        resource.length = 0;
+        resources.Add(resource);
+
+        Manifest manifest;
+        CPPUNIT_ASSERT(manifest.Load(file, "settings"));
+
+        int status = -1;
+        CPPUNIT_ASSERT(!manifest.IsUpToDate(Path("changed.bsp"), Path("changed.res"), resources, status));
+
+        // And a file it read was edited
+        Manifest edited;
+        CPPUNIT_ASSERT(edited.Load(file, "settings"));
+        WriteOldFile(Path("changed.wad"), "other contents");
+        CPPUNIT_ASSERT(!edited.IsUpToDate(Path("changed.bsp"), Path("changed.res"), ResourceIndex(), status));
+    }
+
+    void testOtherSettings()
+    {
+        const std::string file = WriteManifest("settings");
+
+        Manifest manifest;
+        CPPUNIT_ASSERT(manifest.Load(file, "other settings"));
+
+        int status = -1;
+        CPPUNIT_ASSERT(!manifest.IsUpToDate(Path("settings.bsp"), Path("settings.res"), ResourceIndex(), status));
+    }
+
+    void testTruncated()
+    {
+        const std::string file = WriteManifest("truncated");
+
+        std::string contents;
+        CPPUNIT_ASSERT(readFile(file, contents));
+
+        // Cut off after a complete line, before the last dependencies
+        const size_t lastLine = contents.rfind('\n', contents.length() - 2);
+        const size_t boundary = contents.rfind('\n', lastLine - 1) + 1;
+        CheckIgnored(file, contents.substr(0, boundary));
+
+        // Cut off in the middle of a line
+        CheckIgnored(file, contents.substr(0, boundary + 3));
+
+        // Only the end marker is missing
+        CheckIgnored(file, contents.substr(0, lastLine + 1));
+    }
+
+    void testInvalidFile()
+    {
+        Manifest manifest;
+
+        // A missing file is just empty
+        CPPUNIT_ASSERT(manifest.Load(Path("nosuchfile.man"), "settings"));
+
+        const std::string file = WriteManifest("invalid");
+
+        std::string contents;
+        CPPUNIT_ASSERT(readFile(file, contents));
+
+        // Written by another version
+        std::string oldVersion = contents;
+        oldVersion.replace(0, oldVersion.find('\n'), "RESGen manifest 1");
+        CheckIgnored(file, oldVersion);
+
+        // Lines after the end marker, or of an unknown type
+        CheckIgnored(file, contents + "x sound/other.wav\n");
+        CheckIgnored(file, "RESGen manifest 2\nq what\n" + contents.substr(contents.find('\n') + 1));
+    }
+
+private:
+    static std::string Path(const std::string &name)
+    {
+        return testPath(name);
+    }
+
+    // Written long enough ago to be trusted
+    static void WriteOldFile(const std::string &path, const std::string &contents)
+    {
+        writeTestFile(path, contents);
+
+        static time_t old = time(NULL) - 1000;
+        struct utimbuf times;
+        times.actime = old;
+        times.modtime = old++;
+        CPPUNIT_ASSERT(utime(path.c_str(), &times) == 0);
+    }
+
+    // Manifest of a map that read a WAD, found a model and missed a sound
+    static std::string WriteManifest(const std::string &name)
+    {
+        const std::string bsp = Path(name + ".bsp");
+        const std::string res = Path(name + ".res");
+        const std::string wad = Path(name + ".wad");
+        WriteOldFile(bsp, "bsp");
+        WriteOldFile(wad, "wad");
+
+        std::vector<dependency_s> dependencies;
+        dependencies.push_back(Dependency('f', wad, ""));
+        dependencies.push_back(Dependency('r', "models/found.mdl", ""));
+        dependencies.push_back(Dependency('r', "sound/missing.wav", ""));
+
+        const std::string file = Path(name + ".man");
+        Manifest manifest;
+        CPPUNIT_ASSERT(manifest.Load(file, "settings"));
+        manifest.Update(bsp, res, 2, dependencies);
+        WriteOldFile(res, "res");
+        manifest.EndRun();
+
+        CPPUNIT_ASSERT(manifest.Save(file));
+        return file;
+    }
+
+    static dependency_s Dependency(char type, const std::string &name, const std::string &found)
+    {
+        dependency_s dependency;
+        dependency.type = type;
+        dependency.name = name;
+        dependency.found = found;
+        return dependency;
+    }
+
+    static void CheckIgnored(const std::string &file, const std::string &contents)
+    {
+        const std::string ignored = file + ".ignored";
+        writeTestFile(ignored, contents);
+
+        // Nothing is lost by ignoring it, the map is just processed again
+        Manifest manifest;
+        CPPUNIT_ASSERT(manifest.Load(ignored, "settings"));
+
+        const std::string map = file.substr(0, file.length() - 4);
+        int status = -1;
+        CPPUNIT_ASSERT(!manifest.IsUpToDate(map + ".bsp", map + ".res", ResourceIndex(), status));
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ManifestTest);
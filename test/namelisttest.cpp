@@ -0,0 +1,93 @@
+#include <string>
+
+#include "test.h"
+#include "namelist.h"
+
+class NameListTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(NameListTest);
+    CPPUNIT_TEST(testAdd);
+    CPPUNIT_TEST(testSortAndErase);
+    CPPUNIT_TEST(testReuse);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void testAdd()
+    {
+        NameList list;
+        CPPUNIT_ASSERT(list.Empty());
+        CPPUNIT_ASSERT(!list.Contains("a.wav"));
+
+        list.Add("Sound/A.wav");
+        list.Add("sound/b.wav");
+
+        // The case of the last one added is kept
+        list.Add("sound/a.WAV");
+
+        CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(2), list.Size());
+        CPPUNIT_ASSERT(list.Contains("SOUND/A.WAV"));
+        CPPUNIT_ASSERT(!list.Contains("sound/a.wa"));
+        CPPUNIT_ASSERT_EQUAL(std::string("sound/a.WAV"), list[0].name);
+        CPPUNIT_ASSERT_EQUAL(std::string("sound/a.wav"), list[0].nameLower);
+    }
+
+    void testSortAndErase()
+    {
+        NameList list;
+        list.Add("c.wad");
+        list.Add("B.wad");
+        list.Add("a.wad");
+        list.Sort();
+
+        CPPUNIT_ASSERT_EQUAL(std::string("a.wad"), list[0].name);
+        CPPUNIT_ASSERT_EQUAL(std::string("B.wad"), list[1].name);
+        CPPUNIT_ASSERT_EQUAL(std::string("c.wad"), list[2].name);
+
+        // Erased names keep their position
+        list.Erase(1);
+        CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(2), list.Size());
+        CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(3), list.Count());
+        CPPUNIT_ASSERT(list[1].erased);
+        CPPUNIT_ASSERT(!list.Contains("b.wad"));
+
+        // Adding an erased name brings it back in its old place
+        list.Add("b.WAD");
+        CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(3), list.Size());
+        CPPUNIT_ASSERT(!list[1].erased);
+        CPPUNIT_ASSERT_EQUAL(std::string("b.WAD"), list[1].name);
+
+        list.SetName(2, "C.wad");
+        CPPUNIT_ASSERT_EQUAL(std::string("C.wad"), list[2].name);
+        CPPUNIT_ASSERT(list.Contains("c.wad"));
+    }
+
+    void testReuse()
+    {
+        NameList list;
+
+        // Every map reuses the entries of the one before, the table grows
+        // once for the largest map
+        for (int map = 0; map < 50; map++)
+        {
+            list.Clear();
+            CPPUNIT_ASSERT(list.Empty());
+            CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(0), list.Count());
+
+            const int count = (map % 2) ? 1000 : 3;
+            for (int i = count - 1; i >= 0; i--)
+            {
+                list.Add("models/map" + std::to_string(map) + "_" + std::to_string(i) + ".mdl");
+            }
+
+            // Nothing of the map before is left
+            CPPUNIT_ASSERT(!list.Contains("models/map" + std::to_string(map - 1) + "_0.mdl"));
+
+            list.Sort();
+            CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(count), list.Size());
+            CPPUNIT_ASSERT_EQUAL("models/map" + std::to_string(map) + "_0.mdl", list[0].name);
+            CPPUNIT_ASSERT(list.Contains("MODELS/MAP" + std::to_string(map) + "_2.MDL"));
+        }
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(NameListTest);
@@ -0,0 +1,205 @@
+#include <string.h>
+#include <string>
+
+#include "test.h"
+#include "resourceindex.h"
+
+class ResourceIndexTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(ResourceIndexTest);
+    CPPUNIT_TEST(testFind);
+    CPPUNIT_TEST(testEarlierRootWins);
+    CPPUNIT_TEST(testEarlierRootOtherCase);
+    CPPUNIT_TEST(testLooseBeforePak);
+    CPPUNIT_TEST(testPakOfEarlierRoot);
+    CPPUNIT_TEST(testSameRootReplaces);
+    CPPUNIT_TEST(testCopy);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void testFind()
+    {
+        ResourceIndex index;
+        CPPUNIT_ASSERT(!index.HasRoots());
+        CPPUNIT_ASSERT(index.Find("sound/a.wav") == NULL);
+
+        const int mod = index.AddRoot("mod/");
+        CPPUNIT_ASSERT(index.HasRoots());
+
+        index.Add(Loose("Sound/A.wav", mod));
+
+        // Found by lowercase name, with the case found on disk
+        const resource_s *resource = index.Find("sound/a.wav");
+        CPPUNIT_ASSERT(resource != NULL);
+        CPPUNIT_ASSERT_EQUAL(std::string("Sound/A.wav"), std::string(resource->name));
+        CPPUNIT_ASSERT_EQUAL(std::string("mod/Sound/A.wav"), index.GetPath(*resource));
+
+        CPPUNIT_ASSERT(index.Find("sound/a.wa") == NULL);
+        CPPUNIT_ASSERT(index.Find("sound/a.wav2") == NULL);
+    }
+
+    void testEarlierRootWins()
+    {
+        ResourceIndex index;
+        const int mod = index.AddRoot("mod/");
+        const int valve = index.AddRoot("valve/");
+
+        index.Add(Loose("models/player.mdl", mod));
+        index.Add(Loose("models/player.mdl", valve));
+
+        const resource_s *resource = index.Find("models/player.mdl");
+        CPPUNIT_ASSERT(resource != NULL);
+        CPPUNIT_ASSERT_EQUAL(std::string("mod/models/player.mdl"), index.GetPath(*resource));
+    }
+
+    void testEarlierRootOtherCase()
+    {
+        ResourceIndex index;
+        const int mod = index.AddRoot("mod/");
+        const int valve = index.AddRoot("valve/");
+
+        index.Add(Loose("Models/Player.mdl", mod));
+        index.Add(Loose("models/player.mdl", valve));
+
+        // The file of the mod is read, -m writes the case found last
+        const resource_s *resource = index.Find("models/player.mdl");
+        CPPUNIT_ASSERT(resource != NULL);
+        CPPUNIT_ASSERT_EQUAL(std::string("mod/Models/Player.mdl"), index.GetPath(*resource));
+        CPPUNIT_ASSERT_EQUAL(std::string("models/player.mdl"), std::string(resource->name));
+
+        // Also for pak entries of the mod
+        const int pak = index.AddPak("mod/pak0.pak");
+        index.Add(Packed("Sprites/Smoke.spr", mod, pak));
+        index.Add(Loose("sprites/smoke.SPR", valve));
+
+        const resource_s *packed = index.Find("sprites/smoke.spr");
+        CPPUNIT_ASSERT(packed != NULL);
+        CPPUNIT_ASSERT_EQUAL(std::string("mod/pak0.pak"), index.GetPath(*packed));
+        CPPUNIT_ASSERT_EQUAL(std::string("sprites/smoke.SPR"), std::string(packed->name));
+
+        // Copies keep both
+        ResourceIndex copy(index);
+        const resource_s *copied = copy.Find("models/player.mdl");
+        CPPUNIT_ASSERT(copied != NULL);
+        CPPUNIT_ASSERT_EQUAL(std::string("mod/Models/Player.mdl"), copy.GetPath(*copied));
+        CPPUNIT_ASSERT_EQUAL(std::string("models/player.mdl"), std::string(copied->name));
+    }
+
+    void testLooseBeforePak()
+    {
+        ResourceIndex index;
+        const int mod = index.AddRoot("mod/");
+        const int pak = index.AddPak("mod/pak0.pak");
+
+        // Whichever is found first, the loose file is used
+        index.Add(Loose("models/a.mdl", mod));
+        index.Add(Packed("models/a.mdl", mod, pak));
+        index.Add(Packed("models/b.mdl", mod, pak));
+        index.Add(Loose("models/b.mdl", mod));
+
+        const resource_s *a = index.Find("models/a.mdl");
+        CPPUNIT_ASSERT(a != NULL);
+        CPPUNIT_ASSERT_EQUAL(-1, a->pak);
+        CPPUNIT_ASSERT_EQUAL(std::string("mod/models/a.mdl"), index.GetPath(*a));
+
+        const resource_s *b = index.Find("models/b.mdl");
+        CPPUNIT_ASSERT(b != NULL);
+        CPPUNIT_ASSERT_EQUAL(-1, b->pak);
+        CPPUNIT_ASSERT_EQUAL(std::string("mod/models/b.mdl"), index.GetPath(*b));
+    }
+
+    void testPakOfEarlierRoot()
+    {
+        ResourceIndex index;
+        const int mod = index.AddRoot("mod/");
+        const int valve = index.AddRoot("valve/");
+        const int modPak = index.AddPak("mod/pak0.pak");
+        const int valvePak = index.AddPak("valve/pak0.pak");
+
+        // A pak of the mod comes before anything of valve
+        index.Add(Packed("models/player.mdl", mod, modPak));
+        index.Add(Loose("models/player.mdl", valve));
+
+        // A loose file of the mod comes before a pak of valve
+        index.Add(Loose("tex.wad", mod));
+        index.Add(Packed("tex.wad", valve, valvePak));
+
+        const resource_s *player = index.Find("models/player.mdl");
+        CPPUNIT_ASSERT(player != NULL);
+        CPPUNIT_ASSERT_EQUAL(std::string("mod/pak0.pak"), index.GetPath(*player));
+        CPPUNIT_ASSERT_EQUAL(static_cast<uint32_t>(100), player->offset);
+
+        const resource_s *wad = index.Find("tex.wad");
+        CPPUNIT_ASSERT(wad != NULL);
+        CPPUNIT_ASSERT_EQUAL(std::string("mod/tex.wad"), index.GetPath(*wad));
+    }
+
+    void testSameRootReplaces()
+    {
+        ResourceIndex index;
+        const int mod = index.AddRoot("mod/");
+
+        // Files that only differ in case, the last one found is used
+        index.Add(Loose("sprites/a.spr", mod));
+        index.Add(Loose("sprites/A.spr", mod));
+
+        const resource_s *resource = index.Find("sprites/a.spr");
+        CPPUNIT_ASSERT(resource != NULL);
+        CPPUNIT_ASSERT_EQUAL(std::string("sprites/A.spr"), std::string(resource->name));
+    }
+
+    void testCopy()
+    {
+        ResourceIndex index;
+        const int mod = index.AddRoot("mod/");
+
+        // Enough names to grow the table and fill more than one block
+        for (int i = 0; i < 5000; i++)
+        {
+            std::string name = "sound/long/folder/name/to/fill/blocks/file";
+            name += std::to_string(i) + ".wav";
+            index.Add(Loose(name, mod));
+        }
+
+        ResourceIndex copy(index);
+        index = ResourceIndex();
+
+        for (int i = 0; i < 5000; i += 499)
+        {
+            std::string name = "sound/long/folder/name/to/fill/blocks/file";
+            name += std::to_string(i) + ".wav";
+
+            const resource_s *resource = copy.Find(name);
+            CPPUNIT_ASSERT(resource != NULL);
+            CPPUNIT_ASSERT_EQUAL(name, std::string(resource->name));
+        }
+
+        ResourceIndex swapped;
+        swapped.Swap(copy);
+        CPPUNIT_ASSERT(copy.Find("sound/long/folder/name/to/fill/blocks/file0.wav") == NULL);
+        CPPUNIT_ASSERT(swapped.Find("sound/long/folder/name/to/fill/blocks/file0.wav") != NULL);
+    }
+
+private:
+    static resource_s Loose(const std::string &name, int root)
+    {
+        resource_s resource;
+        resource.name = name.c_str(); // Copied by Add
+        resource.root = root;
+        resource.pak = -1;
+        resource.offset = 0;
+        resource.length = 0;
+        return resource;
+    }
+
+    static resource_s Packed(const std::string &name, int root, int pak)
+    {
+        resource_s resource = Loose(name, root);
+        resource.pak = pak;
+        resource.offset = 100;
+        resource.length = 10;
+        return resource;
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ResourceIndexTest);
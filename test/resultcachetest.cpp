@@ -0,0 +1,107 @@
+#include <string>
+
+#include "test.h"
+#include "resultcache.h"
+
+class ResultCacheTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(ResultCacheTest);
+    CPPUNIT_TEST(testReadBack);
+    CPPUNIT_TEST(testKeys);
+    CPPUNIT_TEST(testTruncated);
+    CPPUNIT_TEST(testInvalidFile);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void testReadBack()
+    {
+        ResultCache cache(testPath(""), "settings");
+        const std::string entities = "{ \"classname\" \"worldspawn\" }";
+        const std::string key = cache.MakeKey(entities.data(), entities.length());
+
+        NameList resfile;
+        resfile.Add("sound/b.wav");
+        resfile.Add("Models/A.mdl");
+        resfile.Add("sprites/erased.spr");
+        resfile.Erase(2);
+        cache.Store(key, resfile);
+
+        // Found in the order they were stored, without erased names
+        NameList found;
+        found.Add("sprites/old.spr");
+        CPPUNIT_ASSERT(cache.Find(key, found));
+        CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(2), found.Count());
+        CPPUNIT_ASSERT_EQUAL(std::string("sound/b.wav"), found[0].name);
+        CPPUNIT_ASSERT_EQUAL(std::string("Models/A.mdl"), found[1].name);
+        CPPUNIT_ASSERT(!found.Contains("sprites/old.spr"));
+    }
+
+    void testKeys()
+    {
+        ResultCache cache(testPath(""), "settings");
+        ResultCache other(testPath(""), "other settings");
+
+        const std::string entities = "{ \"classname\" \"worldspawn\" \"wad\" \"a.wad\" }";
+        const std::string key = cache.MakeKey(entities.data(), entities.length());
+
+        // Other entities or settings give another list
+        CPPUNIT_ASSERT(key != cache.MakeKey(entities.data(), entities.length() - 1));
+        CPPUNIT_ASSERT(key != other.MakeKey(entities.data(), entities.length()));
+
+        NameList resfile;
+        resfile.Add("a.wad");
+        cache.Store(key, resfile);
+
+        NameList found;
+        CPPUNIT_ASSERT(cache.Find(key, found));
+        CPPUNIT_ASSERT(!other.Find(other.MakeKey(entities.data(), entities.length()), found));
+    }
+
+    void testTruncated()
+    {
+        ResultCache cache(testPath(""), "settings");
+        NameList found;
+
+        // Cut off in the middle of the last name
+        const std::string midline = "truncated-midline";
+        writeTestFile(testPath(midline + ".lst"), "RESGen result 2\n2\nsound/a.wav\nsound/b.w");
+        CPPUNIT_ASSERT(!cache.Find(midline, found));
+
+        // Cut off after a complete line
+        const std::string boundary = "truncated-boundary";
+        writeTestFile(testPath(boundary + ".lst"), "RESGen result 2\n2\nsound/a.wav\n");
+        CPPUNIT_ASSERT(!cache.Find(boundary, found));
+
+        // Cut off before the count
+        const std::string header = "truncated-header";
+        writeTestFile(testPath(header + ".lst"), "RESGen result 2\n");
+        CPPUNIT_ASSERT(!cache.Find(header, found));
+
+        const std::string complete = "complete";
+        writeTestFile(testPath(complete + ".lst"), "RESGen result 2\n2\nsound/a.wav\nsound/b.wav\n");
+        CPPUNIT_ASSERT(cache.Find(complete, found));
+        CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(2), found.Size());
+    }
+
+    void testInvalidFile()
+    {
+        ResultCache cache(testPath(""), "settings");
+        NameList found;
+
+        CPPUNIT_ASSERT(!cache.Find("nosuchkey", found));
+
+        const std::string oldVersion = "old-version";
+        writeTestFile(testPath(oldVersion + ".lst"), "RESGen result 1\n1\nsound/a.wav\n");
+        CPPUNIT_ASSERT(!cache.Find(oldVersion, found));
+
+        const std::string longer = "longer";
+        writeTestFile(testPath(longer + ".lst"), "RESGen result 2\n1\nsound/a.wav\nsound/b.wav\n");
+        CPPUNIT_ASSERT(!cache.Find(longer, found));
+
+        const std::string badCount = "bad-count";
+        writeTestFile(testPath(badCount + ".lst"), "RESGen result 2\n1x\nsound/a.wav\n");
+        CPPUNIT_ASSERT(!cache.Find(badCount, found));
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ResultCacheTest);
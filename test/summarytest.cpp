@@ -0,0 +1,146 @@
+#include <string>
+#include <vector>
+
+#include "test.h"
+#include "summary.h"
+
+class SummaryTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(SummaryTest);
+    CPPUNIT_TEST(testReadBack);
+    CPPUNIT_TEST(testInvalidFile);
+    CPPUNIT_TEST(testMerge);
+    CPPUNIT_TEST(testMergeMissingShard);
+    CPPUNIT_TEST(testMergeDuplicateShard);
+    CPPUNIT_TEST(testMergeOtherRun);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void testReadBack()
+    {
+        summary_s summary = MakeSummary(2, 3, 7, 2);
+        AddResult(summary.errors, 4, "maps/broken.bsp");
+        AddResult(summary.missing, 1, "maps/with space.bsp");
+
+        const std::string file = testPath("readback.sum");
+        CPPUNIT_ASSERT(WriteSummary(file, summary));
+
+        summary_s read;
+        CPPUNIT_ASSERT(ReadSummary(file, read));
+        CPPUNIT_ASSERT_EQUAL(2u, read.shard);
+        CPPUNIT_ASSERT_EQUAL(3u, read.shardcount);
+        CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(7), read.totalmaps);
+        CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(2), read.mapcount);
+        CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(1), read.errors.size());
+        CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(4), read.errors[0].position);
+        CPPUNIT_ASSERT_EQUAL(std::string("maps/broken.bsp"), read.errors[0].name);
+        CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(1), read.missing.size());
+        CPPUNIT_ASSERT_EQUAL(std::string("maps/with space.bsp"), read.missing[0].name);
+    }
+
+    void testInvalidFile()
+    {
+        summary_s read;
+
+        const std::string noheader = testPath("noheader.sum");
+        writeTestFile(noheader, "shard 1 1\nmaps 1 1\n");
+        CPPUNIT_ASSERT(!ReadSummary(noheader, read));
+
+        const std::string badshard = testPath("badshard.sum");
+        writeTestFile(badshard, "RESGen summary 1\nshard 3 2\nmaps 1 1\n");
+        CPPUNIT_ASSERT(!ReadSummary(badshard, read));
+
+        // Cut off before the map counts
+        const std::string truncated = testPath("truncated.sum");
+        writeTestFile(truncated, "RESGen summary 1\nshard 1 2\n");
+        CPPUNIT_ASSERT(!ReadSummary(truncated, read));
+
+        CPPUNIT_ASSERT(!ReadSummary(testPath("nosuchfile.sum"), read));
+    }
+
+    void testMerge()
+    {
+        // Shards are given in any order, results come back by position
+        summary_s second = MakeSummary(2, 2, 5, 2);
+        AddResult(second.errors, 1, "b.bsp");
+        AddResult(second.missing, 3, "d.bsp");
+
+        summary_s first = MakeSummary(1, 2, 5, 3);
+        AddResult(first.errors, 0, "a.bsp");
+        AddResult(first.errors, 4, "e.bsp");
+
+        std::vector<std::string> files;
+        files.push_back(Write("merge2.sum", second));
+        files.push_back(Write("merge1.sum", first));
+
+        summary_s merged;
+        CPPUNIT_ASSERT(MergeSummaries(files, merged));
+        CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(5), merged.totalmaps);
+        CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(5), merged.mapcount);
+        CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(3), merged.errors.size());
+        CPPUNIT_ASSERT_EQUAL(std::string("a.bsp"), merged.errors[0].name);
+        CPPUNIT_ASSERT_EQUAL(std::string("b.bsp"), merged.errors[1].name);
+        CPPUNIT_ASSERT_EQUAL(std::string("e.bsp"), merged.errors[2].name);
+        CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(1), merged.missing.size());
+        CPPUNIT_ASSERT_EQUAL(std::string("d.bsp"), merged.missing[0].name);
+    }
+
+    void testMergeMissingShard()
+    {
+        std::vector<std::string> files;
+        files.push_back(Write("missing1.sum", MakeSummary(1, 3, 6, 2)));
+        files.push_back(Write("missing3.sum", MakeSummary(3, 3, 6, 2)));
+
+        summary_s merged;
+        CPPUNIT_ASSERT(!MergeSummaries(files, merged));
+    }
+
+    void testMergeDuplicateShard()
+    {
+        std::vector<std::string> files;
+        files.push_back(Write("duplicate1.sum", MakeSummary(1, 2, 4, 2)));
+        files.push_back(Write("duplicate2.sum", MakeSummary(2, 2, 4, 2)));
+        files.push_back(files.front());
+
+        summary_s merged;
+        CPPUNIT_ASSERT(!MergeSummaries(files, merged));
+    }
+
+    void testMergeOtherRun()
+    {
+        std::vector<std::string> files;
+        files.push_back(Write("other1.sum", MakeSummary(1, 2, 4, 2)));
+        files.push_back(Write("other2.sum", MakeSummary(2, 2, 5, 2)));
+
+        summary_s merged;
+        CPPUNIT_ASSERT(!MergeSummaries(files, merged));
+    }
+
+private:
+    static summary_s MakeSummary(unsigned int shard, unsigned int shardcount, size_t totalmaps, size_t mapcount)
+    {
+        summary_s summary;
+        summary.shard = shard;
+        summary.shardcount = shardcount;
+        summary.totalmaps = totalmaps;
+        summary.mapcount = mapcount;
+        return summary;
+    }
+
+    static void AddResult(std::vector<mapresult_s> &results, size_t position, const std::string &name)
+    {
+        mapresult_s result;
+        result.position = position;
+        result.name = name;
+        results.push_back(result);
+    }
+
+    static std::string Write(const std::string &name, const summary_s &summary)
+    {
+        const std::string file = testPath(name);
+        CPPUNIT_ASSERT(WriteSummary(file, summary));
+        return file;
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SummaryTest);
@@ -1,10 +1,43 @@
 #include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
 
 #include <cppunit/extensions/HelperMacros.h>
 #include <cppunit/ui/text/TestRunner.h>
 
 #include "test.h"
 
+std::string testPath(const std::string &name)
+{
+    static std::string folder;
+
+    if (folder.empty())
+    {
+        char path[] = "/tmp/resgen-test-XXXXXX";
+        if (mkdtemp(path) == NULL)
+        {
+            throw std::runtime_error("Could not create a folder for test files");
+        }
+
+        folder = path;
+        folder += '/';
+    }
+
+    return folder + name;
+}
+
+void writeTestFile(const std::string &path, const std::string &contents)
+{
+    FILE *f = fopen(path.c_str(), "wb");
+    if (f == NULL)
+    {
+        throw std::runtime_error("Could not write " + path);
+    }
+
+    fwrite(contents.data(), 1, contents.length(), f);
+    fclose(f);
+}
+
 int main()
 {
     using namespace CppUnit;
@@ -1,2 +1,8 @@
 #include <cppunit/extensions/HelperMacros.h>
 
+#include <string>
+
+// Path of a file in a folder made for this run of the tests
+std::string testPath(const std::string &name);
+
+void writeTestFile(const std::string &path, const std::string &contents);
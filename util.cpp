@@ -19,15 +19,19 @@ along with RESGen; if not, write to the Free Software
 Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
+#include <ctype.h>
 #include <fstream>
 #include <sstream>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <thread>
 
 #ifdef _WIN32
 #include <windows.h>
 #else
 #include <glob.h>
+#include <sched.h>
 #include <sys/types.h>
 #include <dirent.h>
 #include <sys/stat.h>
@@ -251,6 +255,36 @@ void removeSubstring(std::string& str, const char* const substring)
 	}
 }
 
+void appendFormat(std::string &str, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    appendFormatV(str, format, args);
+    va_end(args);
+}
+
+void appendFormatV(std::string &str, const char *format, va_list args)
+{
+    char buffer[1024];
+
+    va_list argsCopy;
+    va_copy(argsCopy, args);
+    const int length = vsnprintf(buffer, sizeof(buffer), format, argsCopy);
+    va_end(argsCopy);
+
+    if (length >= static_cast<int>(sizeof(buffer)))
+    {
+	// Doesn't fit in the stack buffer, format again at full size
+	std::vector<char> largeBuffer(static_cast<size_t>(length) + 1);
+	vsnprintf(largeBuffer.data(), largeBuffer.size(), format, args);
+	str.append(largeBuffer.data(), static_cast<size_t>(length));
+    }
+    else if (length > 0)
+    {
+	str.append(buffer, static_cast<size_t>(length));
+    }
+}
+
 bool readFile(const std::string &filename, std::string &outStr)
 {
     std::ifstream f(filename.c_str());
@@ -266,6 +300,32 @@ bool readFile(const std::string &filename, std::string &outStr)
     return true;
 }
 
+unsigned long long hashData(const void *data, size_t length, unsigned long long hash)
+{
+    const unsigned char *bytes = static_cast<const unsigned char*>(data);
+
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+uint32_t hashStringNoCase(const char *str, size_t length)
+{
+    uint32_t hash = 2166136261U;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= static_cast<uint32_t>(tolower(static_cast<unsigned char>(str[i])));
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
 int ICompareStrings(const std::string &a, const std::string &b)
 {
     return strToLowerCopy(a).compare(strToLowerCopy(b));
@@ -306,3 +366,94 @@ void EndWithPathSep(std::string &str)
 	str += PATH_SEPARATOR;
     }
 }
+
+std::string GetCanonicalPath(const std::string &path)
+{
+    // Resolves relative paths and symlinks so aliases of a file compare equal.
+    // Returns the path unchanged if it can't be resolved.
+#ifdef _WIN32
+    char resolved[MAX_PATH];
+    if (_fullpath(resolved, path.c_str(), MAX_PATH) == NULL)
+    {
+	return path;
+    }
+
+    // Windows paths are case insensitive
+    return strToLowerCopy(resolved);
+#else
+    char *resolved = realpath(path.c_str(), NULL);
+    if (resolved == NULL)
+    {
+	return path;
+    }
+
+    std::string result(resolved);
+    free(resolved);
+    return result;
+#endif
+}
+
+#ifndef _WIN32
+// Returns the number of CPUs the cgroup CPU quota allows, or 0 if unlimited
+static unsigned int GetCgroupCpuLimit()
+{
+    long long quota = -1;
+    long long period = 0;
+
+    std::string str;
+    if (readFile("/sys/fs/cgroup/cpu.max", str))
+    {
+	// cgroup v2: "<quota> <period>", quota can be "max"
+	if (str.compare(0, 3, "max"))
+	{
+	    char *end;
+	    quota = strtoll(str.c_str(), &end, 10);
+	    period = strtoll(end, NULL, 10);
+	}
+    }
+    else
+    {
+	// cgroup v1
+	std::string periodStr;
+	if (
+	    readFile("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", str)
+	&&  readFile("/sys/fs/cgroup/cpu/cpu.cfs_period_us", periodStr)
+	)
+	{
+	    quota = strtoll(str.c_str(), NULL, 10);
+	    period = strtoll(periodStr.c_str(), NULL, 10);
+	}
+    }
+
+    if (quota <= 0 || period <= 0)
+    {
+	return 0;
+    }
+
+    // Round up, a quota of 1.5 CPU can keep 2 workers reasonably busy
+    return static_cast<unsigned int>((quota + period - 1) / period);
+}
+#endif
+
+unsigned int GetAvailableCpuCount()
+{
+    unsigned int count = std::thread::hardware_concurrency();
+
+#ifndef _WIN32
+    // Respect taskset/cpuset restrictions
+    cpu_set_t cpuSet;
+    if (sched_getaffinity(0, sizeof(cpuSet), &cpuSet) == 0)
+    {
+	count = static_cast<unsigned int>(CPU_COUNT(&cpuSet));
+    }
+
+    // And container CPU quotas
+    const unsigned int cgroupLimit = GetCgroupCpuLimit();
+    if (cgroupLimit != 0 && cgroupLimit < count)
+    {
+	count = cgroupLimit;
+    }
+#endif
+
+    return count ? count : 1;
+}
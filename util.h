@@ -13,6 +13,12 @@
 #define INLINE inline
 #endif
 
+#ifdef __GNUC__
+#define PRINTF_FORMAT(formatIndex, firstArg) __attribute__((format(printf, formatIndex, firstArg)))
+#else
+#define PRINTF_FORMAT(formatIndex, firstArg)
+#endif
+
 #ifdef _WIN32
 const char PATH_SEPARATOR = '\\';
 #else
@@ -20,7 +26,9 @@ const char PATH_SEPARATOR = '/';
 #endif
 
 #include <algorithm>
+#include <stdarg.h>
 #include <stdexcept>
+#include <stdint.h>
 #include <string>
 #include <vector>
 
@@ -73,6 +81,21 @@ struct config_s
 	bool checkpak; // t
 	std::string resource_path;
 
+	unsigned int jobs; // 1 - 0 means use all available CPUs
+	unsigned int prefetch; // 4 - maps to read ahead, 0 disables
+
+	unsigned int shard; // 1 - 1 based
+	unsigned int shardcount; // 1
+	std::string summaryfile; // Where to write the run summary, empty for none
+	std::vector<std::string> mergefiles; // Shard summaries to combine
+
+	bool fsync; // f - sync res files to disk before replacing the old ones
+	bool watch; // f - keep processing maps as they change
+	std::string cachefile; // Directory listings of the last run, empty for none
+	std::string manifestfile; // Map inputs of the last run, empty for none
+	std::string assetfile; // Parsed WADs and MDLs of the last run, empty for none
+	std::string resultfolder; // Resource lists of parsed maps, empty for none
+
 #ifdef _WIN32
 	bool keypress; // t
 #else
@@ -189,11 +212,24 @@ bool stripParentheses(std::string& str);
 
 void removeSubstring(std::string& str, const char* const substring);
 
+void appendFormat(std::string &str, const char *format, ...) PRINTF_FORMAT(2, 3);
+void appendFormatV(std::string &str, const char *format, va_list args);
+
 bool readFile(const std::string &filename, std::string &outStr);
 
+// 64 bit FNV-1a, pass the result as hash to continue with more data
+unsigned long long hashData(const void *data, size_t length, unsigned long long hash = 14695981039346656037ULL);
+
+// 32 bit FNV-1a of the lowercase characters, for tables of names in any case
+uint32_t hashStringNoCase(const char *str, size_t length);
+
 int ICompareStrings(const std::string &a, const std::string &b);
 
 std::string BuildValvePath(const std::string &respath);
 void EndWithPathSep(std::string &str);
 
+std::string GetCanonicalPath(const std::string &path);
+
+unsigned int GetAvailableCpuCount();
+
 #endif // UTIL_H
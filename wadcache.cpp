@@ -0,0 +1,149 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <algorithm>
+#include <ctype.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "hltypes.h"
+#include "wadcache.h"
+
+void WadCache::TextureSet::Assign(const char *infotable, size_t lumpcount)
+{
+	names.clear();
+	names.reserve(lumpcount);
+
+	const char *lumpname = infotable + offsetof(wadlumpinfo_s, name);
+
+	for (size_t i = 0; i < lumpcount; i++, lumpname += sizeof(wadlumpinfo_s))
+	{
+		Name name;
+		memcpy(name.chars, lumpname, sizeof(name.chars));
+
+		// Lowercase up to the terminator, clear whatever follows it
+		size_t j = 0;
+		for (; j < sizeof(name.chars) && name.chars[j]; j++)
+		{
+			name.chars[j] = static_cast<char>(tolower(static_cast<unsigned char>(name.chars[j])));
+		}
+		memset(name.chars + j, 0, sizeof(name.chars) - j);
+
+		names.push_back(name);
+	}
+
+	std::sort(names.begin(), names.end(), NameLess);
+}
+
+void WadCache::TextureSet::Clear()
+{
+	names.clear();
+}
+
+void WadCache::TextureSet::Assign(const std::vector<std::string> &texturesLower)
+{
+	names.clear();
+	names.reserve(texturesLower.size());
+
+	for (std::vector<std::string>::const_iterator it = texturesLower.begin(); it != texturesLower.end(); ++it)
+	{
+		Name name;
+		memset(name.chars, 0, sizeof(name.chars));
+		memcpy(name.chars, it->data(), std::min(it->length(), sizeof(name.chars)));
+
+		names.push_back(name);
+	}
+
+	std::sort(names.begin(), names.end(), NameLess);
+}
+
+void WadCache::TextureSet::GetNames(std::vector<std::string> &texturesLower) const
+{
+	texturesLower.clear();
+	texturesLower.reserve(names.size());
+
+	for (std::vector<Name>::const_iterator it = names.begin(); it != names.end(); ++it)
+	{
+		texturesLower.push_back(std::string(it->chars, strnlen(it->chars, sizeof(it->chars))));
+	}
+}
+
+bool WadCache::TextureSet::Contains(const std::string &textureLower) const
+{
+	Name name;
+	if (textureLower.length() > sizeof(name.chars))
+	{
+		return false;
+	}
+
+	memset(name.chars, 0, sizeof(name.chars));
+	memcpy(name.chars, textureLower.data(), textureLower.length());
+
+	return std::binary_search(names.begin(), names.end(), name, NameLess);
+}
+
+bool WadCache::TextureSet::NameLess(const Name &a, const Name &b)
+{
+	return memcmp(a.chars, b.chars, sizeof(a.chars)) < 0;
+}
+
+WadCache::WadCache()
+{
+}
+
+const WadCache::TextureSet &WadCache::GetTextures(const std::string &wadFileLower, const LoadFunction &load)
+{
+	Entry *entry;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		std::unique_ptr<Entry> &slot = entries[wadFileLower];
+		if (!slot)
+		{
+			slot.reset(new Entry);
+		}
+
+		entry = slot.get();
+	}
+
+	// The first caller loads the WAD, any others wait for it to finish
+	std::call_once(entry->loaded, &WadCache::LoadEntry, std::ref(*entry), std::cref(load));
+
+	return entry->textures;
+}
+
+bool WadCache::Contains(const std::string &wadFileLower)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return entries.find(wadFileLower) != entries.end();
+}
+
+void WadCache::LoadEntry(Entry &entry, const LoadFunction &load)
+{
+	if (!load(entry.textures))
+	{
+		// Failed to read wad
+		// Cache this failure with an empty set to prevent wad being marked
+		// as used
+		entry.textures.Clear();
+	}
+}
@@ -0,0 +1,94 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef WADCACHE_H
+#define WADCACHE_H
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Texture names of every WAD file used during a run, shared by all threads.
+// Each WAD is only parsed once, threads that need a WAD that is being parsed
+// wait for that load to finish.
+class WadCache
+{
+public:
+	// Lowercase lump names of one WAD, kept in the fixed 16 byte form WAD
+	// files store them in, sorted so lookups are a binary search
+	class TextureSet
+	{
+	public:
+		// Replaces the names with those of a WAD info table of lumpcount
+		// wadlumpinfo_s entries
+		void Assign(const char *infotable, size_t lumpcount);
+		void Clear();
+
+		// Same names as strings, to store them between runs
+		void Assign(const std::vector<std::string> &texturesLower);
+		void GetNames(std::vector<std::string> &texturesLower) const;
+
+		bool Contains(const std::string &textureLower) const;
+
+	private:
+		struct Name
+		{
+			char chars[16]; // NUL padded
+		};
+
+		static bool NameLess(const Name &a, const Name &b);
+
+		std::vector<Name> names;
+	};
+
+	typedef std::function<bool(TextureSet &textures)> LoadFunction;
+
+	WadCache();
+
+	// Returns the lowercase texture names of a WAD, calling load to fill them
+	// if this WAD hasn't been requested before. A failed load is cached as an
+	// empty set. The returned set stays valid for the lifetime of the cache.
+	const TextureSet &GetTextures(const std::string &wadFileLower, const LoadFunction &load);
+
+	// True if this WAD has been requested before, whether or not it is loaded yet
+	bool Contains(const std::string &wadFileLower);
+
+private:
+	WadCache(const WadCache &other);
+	WadCache& operator=(const WadCache &other);
+
+	struct Entry
+	{
+		std::once_flag loaded;
+		TextureSet textures;
+	};
+
+	static void LoadEntry(Entry &entry, const LoadFunction &load);
+
+	std::mutex mutex; // Only guards adding entries
+	std::map<std::string, std::unique_ptr<Entry> > entries;
+};
+
+#endif
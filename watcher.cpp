@@ -0,0 +1,558 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "dirreader.h"
+#include "mapprocessor.h"
+#include "resgen.h"
+#include "resourcelistbuilder.h"
+#include "summary.h"
+#include "watcher.h"
+
+// Files are processed once they haven't changed for this long
+#define WATCH_SETTLE_MS 250
+
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)
+
+Watcher::Watcher(const config_s &config_, const RESGen &resgen, Manifest &manifest_, AssetStore &assets_, DirCache *dircache)
+	: config(config_)
+	, prototype(resgen)
+	, manifest(manifest_)
+	, assets(assets_)
+	, cache(dircache ? dircache : &localCache)
+	, fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+	, resourcesChanged(false)
+{
+}
+
+Watcher::~Watcher()
+{
+	if (fd >= 0)
+	{
+		close(fd);
+	}
+}
+
+void Watcher::Run(const std::vector<file_s> &files, const std::vector<file_s> &excludes, const std::vector<std::string> &paths,
+	const std::vector<mapfile_s> &maps, const ResourceIndex &resources)
+{
+	if (fd < 0)
+	{
+		printf("Error: Could not watch for changes: %s\n", strerror(errno));
+		return;
+	}
+
+	mapfiles = files;
+	exclusions = excludes;
+	resourcePaths = paths;
+	maplist = maps;
+	resourceIndex = resources;
+
+	for (size_t i = 0; i < mapfiles.size(); i++)
+	{
+		file_s &file = mapfiles[i];
+
+		if (file.folder)
+		{
+			EndWithPathSep(file.name);
+			AddWatch(file.name, static_cast<int>(i), file.recursive, false, false);
+		}
+		else
+		{
+			// Maps are named like ListBuilder names them
+			if (CompareStrEndNoCase(file.name, ".bsp"))
+			{
+				file.name += ".bsp";
+			}
+
+			const size_t separator = file.name.find_last_of('/');
+			AddWatch(file.name.substr(0, (separator == std::string::npos) ? 0 : separator + 1), static_cast<int>(i), false, false, false);
+		}
+	}
+
+	for (std::vector<std::string>::const_iterator it = resourcePaths.begin(); it != resourcePaths.end(); ++it)
+	{
+		AddWatch(*it, -1, true, true, false);
+	}
+
+	printf("Watching " SIZE_T_SPECIFIER " folder(s) for changes. Press Ctrl+C to stop.\n", watches.size());
+	fflush(stdout);
+
+	// while(true) incorrectly triggers MSVC C4127
+	for(;;)
+	{
+		pollfd pfd;
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+
+		if (poll(&pfd, 1, GetTimeout()) < 0 && errno != EINTR)
+		{
+			printf("Error: Could not watch for changes: %s\n", strerror(errno));
+			return;
+		}
+
+		if ((pfd.revents & POLLIN) && !ReadEvents())
+		{
+			return;
+		}
+
+		ProcessChanges();
+	}
+}
+
+void Watcher::AddWatch(const std::string &path, int mapfile, bool recursive, bool resources, bool scan)
+{
+	const int wd = inotify_add_watch(fd, path.empty() ? "." : path.c_str(), WATCH_MASK);
+	if (wd < 0)
+	{
+		printf("Warning: Could not watch %s for changes: %s\n", path.empty() ? "." : path.c_str(), strerror(errno));
+		return;
+	}
+
+	// The same folder may be a map folder and in a resource path, or be
+	// reached again through a symlink
+	std::map<int, Watch>::iterator it = watches.find(wd);
+	const bool added = (it == watches.end());
+
+	if (added)
+	{
+		Watch watch;
+		watch.path = path;
+		watch.mapfile = -1;
+		watch.recursive = false;
+		watch.resources = false;
+		it = watches.insert(std::make_pair(wd, watch)).first;
+	}
+
+	Watch &watch = it->second;
+	bool changed = added;
+
+	// A map folder takes precedence over single maps in it
+	if (mapfile >= 0 && (watch.mapfile < 0 || (mapfiles[static_cast<size_t>(mapfile)].folder && !mapfiles[static_cast<size_t>(watch.mapfile)].folder)))
+	{
+		watch.mapfile = mapfile;
+		watch.recursive = recursive;
+		changed = true;
+	}
+
+	if (!watch.resources && resources)
+	{
+		watch.resources = true;
+		changed = true;
+	}
+
+	if (!changed || !(watch.recursive || watch.resources || scan))
+	{
+		return;
+	}
+
+	// Subfolders get watched too. Files in a folder that was just created
+	// may have been written before the watch was there.
+	DirReader directory;
+	if (!directory.Open(path.empty() ? "." : path, watch.resources || config.symlink))
+	{
+		return;
+	}
+
+	const Watch parent = watch;
+	std::vector<std::string> subfolders;
+	bool isdir;
+
+	for (const char *name = directory.Next(isdir); name; name = directory.Next(isdir))
+	{
+		if (isdir)
+		{
+			subfolders.push_back(name);
+		}
+		else if (scan)
+		{
+			FileChanged(parent, name);
+		}
+	}
+
+	directory.Close();
+
+	for (std::vector<std::string>::const_iterator subIt = subfolders.begin(); subIt != subfolders.end(); ++subIt)
+	{
+		if (parent.recursive || parent.resources)
+		{
+			AddWatch(parent.path + *subIt + '/', parent.recursive ? parent.mapfile : -1, parent.recursive, parent.resources, scan);
+		}
+	}
+}
+
+bool Watcher::ReadEvents()
+{
+	alignas(inotify_event) char buffer[65536];
+
+	// while(true) incorrectly triggers MSVC C4127
+	for(;;)
+	{
+		const ssize_t length = read(fd, buffer, sizeof(buffer));
+
+		if (length < 0)
+		{
+			if (errno == EAGAIN || errno == EINTR)
+			{
+				return true;
+			}
+
+			printf("Error: Could not watch for changes: %s\n", strerror(errno));
+			return false;
+		}
+
+		for (ssize_t offset = 0; offset < length; )
+		{
+			const inotify_event *event = reinterpret_cast<const inotify_event*>(buffer + offset);
+			offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				// Changed maps that are known are found through the manifest
+				printf("Warning: Too many changes at once, new maps may have been missed.\n");
+				resourcesChanged = true;
+				resourceChangeTime = Clock::now();
+				continue;
+			}
+
+			std::map<int, Watch>::iterator it = watches.find(event->wd);
+			if (it == watches.end())
+			{
+				continue;
+			}
+
+			if (event->mask & IN_IGNORED)
+			{
+				// Folder was removed
+				watches.erase(it);
+				continue;
+			}
+
+			if (event->len == 0)
+			{
+				continue;
+			}
+
+			const Watch watch = it->second;
+			const std::string name = event->name;
+
+			if (event->mask & IN_ISDIR)
+			{
+				if ((event->mask & (IN_CREATE | IN_MOVED_TO)) && (watch.recursive || watch.resources))
+				{
+					AddWatch(watch.path + name + '/', watch.recursive ? watch.mapfile : -1, watch.recursive, watch.resources, true);
+				}
+
+				if (watch.resources)
+				{
+					resourcesChanged = true;
+					resourceChangeTime = Clock::now();
+				}
+			}
+			else if (event->mask & (IN_MODIFY | IN_CREATE))
+			{
+				// Still being written, only postpones a change that was
+				// seen before
+				PendingMap::iterator pendingIt = changedMaps.find(watch.path + name);
+				if (pendingIt != changedMaps.end())
+				{
+					pendingIt->second.changed = Clock::now();
+				}
+
+				if ((event->mask & IN_CREATE) && CompareStrEndNoCase(name, ".bsp"))
+				{
+					// Resources only have to exist, -u reads them once
+					// they are closed
+					FileChanged(watch, name);
+				}
+			}
+			else
+			{
+				FileChanged(watch, name);
+			}
+		}
+	}
+}
+
+void Watcher::FileChanged(const Watch &watch, const std::string &name)
+{
+	const std::string path = watch.path + name;
+
+	if (!CompareStrEndNoCase(name, ".bsp"))
+	{
+		// Maps don't depend on other maps, they aren't resources here
+		int mapfile = -1;
+
+		if (watch.mapfile >= 0 && mapfiles[static_cast<size_t>(watch.mapfile)].folder)
+		{
+			mapfile = watch.mapfile;
+		}
+		else
+		{
+			for (size_t i = 0; i < mapfiles.size() && mapfile < 0; i++)
+			{
+				if (!mapfiles[i].folder && mapfiles[i].name == path)
+				{
+					mapfile = static_cast<int>(i);
+				}
+			}
+		}
+
+		if (mapfile >= 0)
+		{
+			Pending &pending = changedMaps[path];
+			pending.changed = Clock::now();
+			pending.mapfile = mapfile;
+		}
+	}
+	else if (watch.resources && !IsOwnFile(name))
+	{
+		resourcesChanged = true;
+		resourceChangeTime = Clock::now();
+	}
+}
+
+bool Watcher::IsOwnFile(const std::string &name) const
+{
+	// Res files and the files of the options below are written by RESGen
+	// itself, and so are .tmp files. Changes to them would start a new
+	// round after every round.
+	if (!CompareStrEndNoCase(name, ".res") || !CompareStrEndNoCase(name, ".tmp"))
+	{
+		return true;
+	}
+
+	const std::string *files[] = { &config.cachefile, &config.manifestfile, &config.assetfile };
+
+	for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++)
+	{
+		const size_t separator = files[i]->find_last_of('/');
+		if (!files[i]->empty() && files[i]->compare((separator == std::string::npos) ? 0 : separator + 1, std::string::npos, name) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int Watcher::GetTimeout() const
+{
+	Clock::time_point first = Clock::time_point::max();
+
+	for (PendingMap::const_iterator it = changedMaps.begin(); it != changedMaps.end(); ++it)
+	{
+		first = std::min(first, it->second.changed);
+	}
+
+	if (resourcesChanged)
+	{
+		first = std::min(first, resourceChangeTime);
+	}
+
+	if (first == Clock::time_point::max())
+	{
+		return -1;
+	}
+
+	const long long wait = WATCH_SETTLE_MS - std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - first).count();
+	return (wait > 0) ? static_cast<int>(wait) : 0;
+}
+
+void Watcher::ProcessChanges()
+{
+	const Clock::time_point now = Clock::now();
+	const std::chrono::milliseconds settle(WATCH_SETTLE_MS);
+
+	std::vector<std::pair<std::string, int> > settled;
+	for (PendingMap::iterator it = changedMaps.begin(); it != changedMaps.end(); )
+	{
+		if (now - it->second.changed >= settle)
+		{
+			settled.push_back(std::make_pair(it->first, it->second.mapfile));
+			changedMaps.erase(it++);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	const bool updateResources = resourcesChanged && now - resourceChangeTime >= settle;
+
+	if (settled.empty() && !updateResources)
+	{
+		return;
+	}
+
+	// Files changed before now can be trusted again by the manifest, the
+	// asset store and the cache
+	manifest.BeginRun();
+	prototype.BeginRun(updateResources);
+	cache->BeginRun();
+
+	if (updateResources)
+	{
+		resourcesChanged = false;
+		UpdateResources();
+	}
+
+	std::vector<mapfile_s> todo;
+
+	for (std::vector<std::pair<std::string, int> >::const_iterator it = settled.begin(); it != settled.end(); ++it)
+	{
+		for (std::vector<mapfile_s>::iterator mapIt = maplist.begin(); mapIt != maplist.end(); )
+		{
+			if (mapIt->name == it->first)
+			{
+				mapIt = maplist.erase(mapIt);
+			}
+			else
+			{
+				++mapIt;
+			}
+		}
+
+		manifest.Forget(it->first);
+
+		if (!fileExists(it->first))
+		{
+			// Removed, its res file is left alone
+			continue;
+		}
+
+		// Excludes and shards still apply
+		const file_s &file = mapfiles[static_cast<size_t>(it->second)];
+		std::vector<mapfile_s> found;
+		ListBuilder listbuild(&found, exclusions, config.verbal, config.searchdisp);
+		listbuild.SetShard(config.shard, config.shardcount);
+		listbuild.AddFoundMap(it->first, file.folder ? file.name.length() : it->first.find_last_of('/') + 1);
+
+		maplist.insert(maplist.end(), found.begin(), found.end());
+		todo.insert(todo.end(), found.begin(), found.end());
+	}
+
+	if (updateResources)
+	{
+		// Only maps that depend on a resource that changed
+		const size_t changed = todo.size();
+
+		for (std::vector<mapfile_s>::const_iterator it = maplist.begin(); it != maplist.end(); ++it)
+		{
+			bool queued = false;
+			for (size_t i = 0; i < changed && !queued; i++)
+			{
+				queued = (todo[i].name == it->name);
+			}
+
+			std::string basefolder;
+			std::string basefilename;
+			splitPath(it->name, basefolder, basefilename);
+
+			int status;
+			if (!queued && it->valid && !manifest.IsUpToDate(it->name, basefolder + basefilename + ".res", resourceIndex, status))
+			{
+				todo.push_back(*it);
+			}
+		}
+	}
+
+	if (todo.empty())
+	{
+		return;
+	}
+
+	if (config.verbal)
+	{
+		printf("\n");
+	}
+
+	std::vector<int> results;
+	MapProcessor mapProcessor(config, prototype);
+	mapProcessor.ProcessMaps(todo, resourceIndex, results);
+
+	summary_s summary;
+	summary.shard = config.shard;
+	summary.shardcount = config.shardcount;
+	summary.totalmaps = todo.size();
+	summary.mapcount = todo.size();
+
+	for (size_t i = 0; i < todo.size(); i++)
+	{
+		mapresult_s result;
+		result.position = i;
+		result.name = todo[i].name;
+
+		if (results[i] == 1)
+		{
+			// Failed maps are always processed again
+			manifest.Forget(result.name);
+			summary.errors.push_back(result);
+		}
+		else if (results[i] == 2)
+		{
+			summary.missing.push_back(result);
+		}
+	}
+
+	manifest.EndRun();
+
+	if (!config.manifestfile.empty())
+	{
+		manifest.Save(config.manifestfile);
+	}
+
+	if (!config.assetfile.empty())
+	{
+		assets.Save(config.assetfile);
+	}
+
+	showsummary(summary, config.verbal);
+
+	// Output may go to a log file, which would only get it in large blocks
+	fflush(stdout);
+}
+
+void Watcher::UpdateResources()
+{
+	// Only folders that changed are listed again
+	ResourceListBuilder resourceListBuilder(config);
+	resourceListBuilder.SetCache(cache);
+	resourceListBuilder.BuildResourceList(resourcePaths, config.checkpak, config.resourcedisp);
+
+	resourceIndex.Swap(resourceListBuilder.resources);
+
+	if (!config.cachefile.empty())
+	{
+		cache->Save(config.cachefile);
+	}
+}
+
+#endif // __linux__
@@ -0,0 +1,111 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef WATCHER_H
+#define WATCHER_H
+
+#ifdef __linux__
+
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "assetstore.h"
+#include "dircache.h"
+#include "listbuilder.h"
+#include "manifest.h"
+#include "resgenclass.h"
+#include "resourceindex.h"
+#include "util.h"
+
+// Keeps the map list and resource list of a run, and processes maps again
+// as they change. New and modified maps are processed once they have been
+// closed and left alone for a moment, so maps that are still being uploaded
+// aren't. Changed resources update the resource list, after which only the
+// maps the manifest says depend on them are processed again.
+class Watcher
+{
+public:
+	Watcher(const config_s &config, const RESGen &resgen, Manifest &manifest, AssetStore &assets, DirCache *cache);
+	~Watcher();
+
+	// files and excludes are the map folders, maps and exclusions of the
+	// command line, maps and resources the lists made from them. Only
+	// returns if watching fails.
+	void Run(const std::vector<file_s> &files, const std::vector<file_s> &excludes, const std::vector<std::string> &resourcePaths,
+		const std::vector<mapfile_s> &maps, const ResourceIndex &resources);
+
+private:
+	Watcher(const Watcher &other);
+	Watcher& operator=(const Watcher &other);
+
+	typedef std::chrono::steady_clock Clock;
+
+	struct Watch
+	{
+		std::string path; // Ends with a separator, empty for the current folder
+		int mapfile; // Index in files of the map or map folder it is watched for, -1 if none
+		bool recursive; // Subfolders are watched too
+		bool resources; // Inside a resource path
+	};
+
+	// A map that changed, processed once it is left alone for a moment
+	struct Pending
+	{
+		Clock::time_point changed;
+		int mapfile; // Index in mapfiles
+	};
+	typedef std::map<std::string, Pending> PendingMap;
+
+	void AddWatch(const std::string &path, int mapfile, bool recursive, bool resources, bool scan);
+	bool ReadEvents();
+	void FileChanged(const Watch &watch, const std::string &name);
+	bool IsOwnFile(const std::string &name) const;
+	int GetTimeout() const;
+	void ProcessChanges();
+	void UpdateResources();
+
+	const config_s &config;
+	RESGen prototype; // Copy, WADs are read again after resources changed
+	Manifest &manifest;
+	AssetStore &assets;
+	DirCache localCache; // Used when no cache file was given
+	DirCache *cache;
+
+	int fd; // inotify instance
+	std::map<int, Watch> watches; // By watch descriptor
+
+	std::vector<file_s> mapfiles;
+	std::vector<file_s> exclusions;
+	std::vector<std::string> resourcePaths;
+	std::vector<mapfile_s> maplist;
+	ResourceIndex resourceIndex;
+
+	PendingMap changedMaps; // By map path
+	bool resourcesChanged;
+	Clock::time_point resourceChangeTime;
+};
+
+#endif // __linux__
+
+#endif // WATCHER_H
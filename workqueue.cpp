@@ -0,0 +1,121 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "workqueue.h"
+
+WorkQueue::WorkQueue(unsigned int jobs)
+	: runningTasks(0)
+	, stopping(false)
+{
+	// The thread calling Wait() is one of the jobs
+	for (unsigned int i = 1; i < jobs; i++)
+	{
+		threads.push_back(std::thread(&WorkQueue::RunWorker, this));
+	}
+}
+
+WorkQueue::~WorkQueue()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	stateChanged.notify_all();
+
+	for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+	{
+		it->join();
+	}
+}
+
+void WorkQueue::Add(const Task &task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(task);
+	}
+
+	stateChanged.notify_one();
+}
+
+void WorkQueue::Wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	// while(true) incorrectly triggers MSVC C4127
+	for(;;)
+	{
+		if (RunNextTask(lock))
+		{
+			continue;
+		}
+
+		if (runningTasks == 0)
+		{
+			// Nothing queued and nothing that can add new tasks
+			return;
+		}
+
+		// Another thread is still busy and might add tasks
+		stateChanged.wait(lock);
+	}
+}
+
+void WorkQueue::RunWorker()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (!stopping)
+	{
+		if (!RunNextTask(lock))
+		{
+			stateChanged.wait(lock);
+		}
+	}
+}
+
+bool WorkQueue::RunNextTask(std::unique_lock<std::mutex> &lock)
+{
+	if (tasks.empty())
+	{
+		return false;
+	}
+
+	Task task;
+	task.swap(tasks.front());
+	tasks.pop_front();
+	runningTasks++;
+
+	lock.unlock();
+	task();
+	lock.lock();
+
+	runningTasks--;
+
+	if (runningTasks == 0 && tasks.empty())
+	{
+		// Everything is done, wake up Wait()
+		stateChanged.notify_all();
+	}
+
+	return true;
+}
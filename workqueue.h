@@ -0,0 +1,64 @@
+/*
+RESGen. A tool to create .res files for Half-Life.
+Copyright (C) 2000-2005 Jeroen Bogers
+
+This file is part of RESGen.
+
+RESGen is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+RESGen is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RESGen; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Simple thread pool. Tasks can add new tasks to the queue while running.
+// The thread calling Wait() helps running tasks, so a queue with one job
+// doesn't start any threads and runs everything on the calling thread.
+class WorkQueue
+{
+public:
+	typedef std::function<void()> Task;
+
+	explicit WorkQueue(unsigned int jobs);
+	~WorkQueue();
+
+	void Add(const Task &task);
+
+	// Runs tasks until the queue is empty and no task is running anymore
+	void Wait();
+
+private:
+	WorkQueue(const WorkQueue &other);
+	WorkQueue& operator=(const WorkQueue &other);
+
+	void RunWorker();
+	bool RunNextTask(std::unique_lock<std::mutex> &lock);
+
+	std::mutex mutex;
+	std::condition_variable stateChanged;
+	std::deque<Task> tasks;
+	size_t runningTasks;
+	bool stopping;
+	std::vector<std::thread> threads;
+};
+
+#endif